@@ -0,0 +1,220 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "bmp180.h"
+
+// BMP180 registers and commands (see BMP180 datasheet)
+const uint8_t bmp180_reg_calibration = 0xAA;
+const uint8_t bmp180_reg_chip_id = 0xD0;
+const uint8_t bmp180_reg_control = 0xF4;
+const uint8_t bmp180_reg_result = 0xF6;
+const uint8_t bmp180_chip_id = 0x55;
+const uint8_t bmp180_cmd_temperature = 0x2E;
+const uint8_t bmp180_cmd_pressure = 0x34;
+const int bmp180_temperature_delay = 5;     // ms
+const int bmp180_pressure_delay = 26;       // ms, ultra high resolution
+
+// BMP180 task (runs on core 0 next to the acquisition task)
+const int bmp180Core = 0;
+const int bmp180Priority = 1;
+const int bmp180StackSize = 2048;
+
+/* 
+ * Altitude table: (p / p0) ^ (1 / 5.255) for p / p0 from 0.3 to 1.1 (about 9000 m above
+ * sea level down to 800 m below sea level). It is calculated once at startup, afterwards the
+ * altitude is a linear interpolation. The interpolation error is below 1.2 m at 0.3 and
+ * about 0.1 m near sea level.
+ */
+const int altitude_table_size = 65;
+const float altitude_table_min = 0.3F;
+const float altitude_table_step = 0.0125F;
+static float altitude_table[altitude_table_size];
+
+bool BMP180Sensor::begin(uint8_t _address)
+{
+    address = _address;
+
+    for (int i = 0; i < altitude_table_size; i++)
+    {
+        altitude_table[i] = powf(altitude_table_min + i * altitude_table_step, 1.0F / 5.255F);
+    }
+
+    uint8_t reg = bmp180_reg_chip_id;
+    uint8_t id = 0;
+    if (bus.writeRead(address, &reg, 1, &id, 1) != I2C_OK || id != bmp180_chip_id)
+    {
+        Serial.println("(I) - BMP180 not found");
+        return false;
+    }
+    if (!readCalibration())
+    {
+        Serial.println("(I) - BMP180 calibration read failed");
+        return false;
+    }
+
+    readingQueue = xQueueCreate(1, sizeof(BMP180Reading));
+    xTaskCreatePinnedToCore(readingTask, "bmp180", bmp180StackSize, this, 
+        bmp180Priority, NULL, bmp180Core);
+    return true;
+}
+
+bool BMP180Sensor::latest(BMP180Reading *reading)
+{
+    return readingQueue != NULL && xQueuePeek(readingQueue, reading, 0);
+}
+
+void BMP180Sensor::readingTask(void *parameter)
+{
+    BMP180Sensor *sensor = (BMP180Sensor *) parameter;
+    for (;;)
+    {
+        // vTaskDelay may return up to one tick early (the conversion times are maximums)
+        vTaskDelay(pdMS_TO_TICKS(sensor->step()) + 1);
+    }
+}
+
+/* 
+ * One step of the state machine, returns the time until the next step
+ */
+int BMP180Sensor::step()
+{
+    uint8_t buffer[3];
+    switch (state)
+    {
+        case BMP180_START_TEMPERATURE:
+            if (startConversion(bmp180_cmd_temperature))
+            {
+                state = BMP180_READ_TEMPERATURE;
+                return bmp180_temperature_delay;
+            }
+            return readingInterval;
+
+        case BMP180_READ_TEMPERATURE:
+            if (readResult(buffer, 2) && startConversion(bmp180_cmd_pressure | (oversampling << 6)))
+            {
+                rawTemperature = (buffer[0] << 8) | buffer[1];
+                state = BMP180_READ_PRESSURE;
+                return bmp180_pressure_delay;
+            }
+            break;
+
+        case BMP180_READ_PRESSURE:
+            if (readResult(buffer, 3))
+            {
+                int32_t rawPressure = (((int32_t) buffer[0] << 16) | ((int32_t) buffer[1] << 8) | buffer[2]) 
+                    >> (8 - oversampling);
+
+                BMP180Reading reading;
+                reading.temperature = temperature();
+                reading.pressure = pressure(rawPressure);
+                reading.altitude = pressureToAltitude(seaLevelPressure, reading.pressure);
+                reading.timestamp = millis();
+                xQueueOverwrite(readingQueue, &reading);
+            }
+            break;
+    }
+
+    state = BMP180_START_TEMPERATURE;
+    return readingInterval;
+}
+
+bool BMP180Sensor::readCalibration()
+{
+    uint8_t reg;
+    uint8_t buffer[22];
+
+    // the transactions of the bus are limited, so the 22 bytes are read in chunks
+    for (int offset = 0; offset < 22; offset += 2)
+    {
+        reg = bmp180_reg_calibration + offset;
+        if (bus.writeRead(address, &reg, 1, buffer + offset, 2) != I2C_OK)
+        {
+            return false;
+        }
+    }
+
+    ac1 = (buffer[0] << 8) | buffer[1];
+    ac2 = (buffer[2] << 8) | buffer[3];
+    ac3 = (buffer[4] << 8) | buffer[5];
+    ac4 = (buffer[6] << 8) | buffer[7];
+    ac5 = (buffer[8] << 8) | buffer[9];
+    ac6 = (buffer[10] << 8) | buffer[11];
+    b1 = (buffer[12] << 8) | buffer[13];
+    b2 = (buffer[14] << 8) | buffer[15];
+    mb = (buffer[16] << 8) | buffer[17];
+    mc = (buffer[18] << 8) | buffer[19];
+    md = (buffer[20] << 8) | buffer[21];
+    return true;
+}
+
+bool BMP180Sensor::startConversion(uint8_t command)
+{
+    uint8_t data[2] = { bmp180_reg_control, command };
+    return bus.write(address, data, 2) == I2C_OK;
+}
+
+bool BMP180Sensor::readResult(uint8_t *buffer, uint8_t length)
+{
+    uint8_t reg = bmp180_reg_result;
+    return bus.writeRead(address, &reg, 1, buffer, length) == I2C_OK;
+}
+
+float BMP180Sensor::temperature()
+{
+    // integer compensation of the datasheet, b5 is needed for the pressure
+    int32_t x1 = ((rawTemperature - (int32_t) ac6) * (int32_t) ac5) >> 15;
+    int32_t x2 = ((int32_t) mc << 11) / (x1 + md);
+    b5 = x1 + x2;
+    return ((b5 + 8) >> 4) / 10.0F;
+}
+
+float BMP180Sensor::pressure(int32_t rawPressure)
+{
+    int32_t b6 = b5 - 4000;
+    int32_t x1 = (b2 * ((b6 * b6) >> 12)) >> 11;
+    int32_t x2 = (ac2 * b6) >> 11;
+    int32_t x3 = x1 + x2;
+    int32_t b3 = ((((int32_t) ac1 * 4 + x3) << oversampling) + 2) / 4;
+    x1 = (ac3 * b6) >> 13;
+    x2 = (b1 * ((b6 * b6) >> 12)) >> 16;
+    x3 = ((x1 + x2) + 2) >> 2;
+    uint32_t b4 = ((uint32_t) ac4 * (uint32_t) (x3 + 32768)) >> 15;
+    uint32_t b7 = ((uint32_t) rawPressure - b3) * (uint32_t) (50000UL >> oversampling);
+
+    int32_t p;
+    if (b7 < 0x80000000)
+    {
+        p = (b7 * 2) / b4;
+    }
+    else
+    {
+        p = (b7 / b4) * 2;
+    }
+    x1 = (p >> 8) * (p >> 8);
+    x1 = (x1 * 3038) >> 16;
+    x2 = (-7357 * p) >> 16;
+    p = p + ((x1 + x2 + 3791) >> 4);
+
+    return p / 100.0F;
+}
+
+float BMP180Sensor::pressureToAltitude(float seaLevel, float p)
+{
+    // international barometric formula: 44330 * (1 - (p / p0) ^ (1 / 5.255))
+    float x = (p / seaLevel - altitude_table_min) * (1.0F / altitude_table_step);
+    if (!(x > 0))
+    {
+        return 44330.0F * (1.0F - altitude_table[0]);
+    }
+    if (x >= altitude_table_size - 1)
+    {
+        return 44330.0F * (1.0F - altitude_table[altitude_table_size - 1]);
+    }
+    int i = (int) x;
+    float f = x - i;
+    return 44330.0F * (1.0F - (altitude_table[i] + f * (altitude_table[i + 1] - altitude_table[i])));
+}
@@ -0,0 +1,66 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _bmp180_h_
+#define _bmp180_h_
+
+#include <Arduino.h>
+
+#include "i2cbus.h"
+
+/* 
+ * This class holds the latest reading of the BMP180 background task
+ */
+class BMP180Reading
+{
+public:
+    float temperature = 0; // °C
+    float pressure = 0;    // hPa
+    float altitude = 0;    // m
+    unsigned long timestamp = 0;
+};
+
+/* 
+ * This class drives the BMP180 as a background state machine in its own task: a temperature
+ * conversion and an ultra high resolution pressure conversion (8 samples) are started one 
+ * after the other and collected when they are ready. The measurement only takes the latest 
+ * reading out of a single slot queue and never waits for a conversion.
+ */
+class BMP180Sensor
+{
+public:
+    static const int oversampling = 3;          // ultra high resolution
+    static const int readingInterval = 2000;    // ms
+    static constexpr float seaLevelPressure = 1013.25F; // hPa
+    bool begin(uint8_t _address);
+    bool latest(BMP180Reading *reading);
+    static float pressureToAltitude(float seaLevel, float p);
+private:
+    enum State
+    {
+        BMP180_START_TEMPERATURE,
+        BMP180_READ_TEMPERATURE,
+        BMP180_READ_PRESSURE
+    };
+    uint8_t address = 0x77;
+    State state = BMP180_START_TEMPERATURE;
+    int16_t ac1, ac2, ac3, b1, b2, mb, mc, md;
+    uint16_t ac4, ac5, ac6;
+    int32_t b5 = 0;
+    int32_t rawTemperature = 0;
+    QueueHandle_t readingQueue;
+    I2CClient bus;
+    static void readingTask(void *parameter);
+    int step();
+    bool readCalibration();
+    bool startConversion(uint8_t command);
+    bool readResult(uint8_t *buffer, uint8_t length);
+    float temperature();
+    float pressure(int32_t rawPressure);
+};
+
+#endif
@@ -0,0 +1,164 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "calibration.h"
+
+#include "FS.h"
+#include "SPIFFS.h"
+
+bool CalibrationModel::load(const char * path, uint32_t serial_no)
+{
+    loaded = false;
+    modelVersion = 0;
+
+    if(!SPIFFS.begin()) 
+    {
+        Serial.println("(I) - SPIFFS mount failed");
+        return false;
+    }
+
+    File file = SPIFFS.open(path);
+    if(!file)
+    {
+        Serial.printf("(I) - no calibration file: %s\n", path);
+        return false;
+    }
+
+    // the rest of a line which does not fit into the buffer is skipped with the line
+    char line[160];
+    int length = 0;
+    bool overlong = false;
+    while(file.available())
+    {
+        char c = file.read();
+        if (c == '\n')
+        {
+            line[length] = 0;
+            if (overlong)
+            {
+                Serial.println("(I) - calibration line too long, skipped");
+            }
+            else
+            {
+                parseLine(line, serial_no);
+            }
+            length = 0;
+            overlong = false;
+        }
+        else if (length == sizeof(line) - 1)
+        {
+            overlong = true;
+        }
+        else if (c != '\r')
+        {
+            line[length++] = c;
+        }
+    }
+    line[length] = 0;
+    if (!overlong)
+    {
+        parseLine(line, serial_no);
+    }
+    file.close();
+
+    if (loaded)
+    {
+        Serial.printf("(I) - calibration version %d loaded for sensor %u\n", modelVersion, serial_no);
+    }
+    else
+    {
+        Serial.printf("(I) - no calibration for sensor %u in %s\n", serial_no, path);
+    }
+    return loaded;
+}
+
+bool CalibrationModel::parseLine(char * line, uint32_t serial_no)
+{
+    if (line[0] == '#' || line[0] == 0)
+    {
+        return false;
+    }
+
+    // version,serial_no,intercept,we,ae,temperature,humidity,pressure
+    char * next;
+    long lineVersion = strtol(line, &next, 10);
+    if (next == line || *next != ',' || lineVersion < 1 || lineVersion > versionMax)
+    {
+        return false;
+    }
+    char * field = next + 1;
+    unsigned long lineSerial = strtoul(field, &next, 10);
+    if (next == field || *next != ',' || lineSerial != serial_no)
+    {
+        return false;
+    }
+
+    float values[inputCount + 1];
+    for (int i = 0; i < inputCount + 1; i++)
+    {
+        if (*next != ',')
+        {
+            return false;
+        }
+        field = next + 1;
+        values[i] = strtof(field, &next);
+        if (next == field)
+        {
+            return false;
+        }
+    }
+    if (*next != 0)
+    {
+        // trailing characters or more fields than the model has
+        return false;
+    }
+
+    // keep the newest coefficient set of the sensor
+    if (loaded && lineVersion <= modelVersion)
+    {
+        return false;
+    }
+    modelVersion = lineVersion;
+    intercept = values[0];
+    for (int i = 0; i < inputCount; i++)
+    {
+        coefficients[i] = values[i + 1];
+    }
+    loaded = true;
+    return true;
+}
+
+bool CalibrationModel::isLoaded()
+{
+    return loaded;
+}
+
+uint16_t CalibrationModel::version()
+{
+    return modelVersion;
+}
+
+float CalibrationModel::evaluate(EnvironmentData *data)
+{
+    if (!loaded)
+    {
+        return 0;
+    }
+
+    float ugm3 = intercept
+        + coefficients[0] * data->no2_we
+        + coefficients[1] * data->no2_ae
+        + coefficients[2] * data->sht31_temperature
+        + coefficients[3] * data->sht31_humidity
+        + coefficients[4] * data->bmp180_pressure;
+
+    if (ugm3 < 0)
+    {
+        return 0;
+    }
+    return ugm3;
+}
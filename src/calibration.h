@@ -0,0 +1,43 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _calibration_h_
+#define _calibration_h_
+
+#include "measurement.h"
+#include "payloadschema.h"
+
+/* 
+ * This class holds the coefficients of the multiple linear regression (LibreOffice LINEST)
+ * which converts WE, AE, temperature, humidity and pressure into NO2 in ug/m3 like the 
+ * official measurement station does.
+ * 
+ * The coefficients are loaded from a csv-file on the flash memory (SPIFFS), one coefficient 
+ * set per line. The set with the highest version for the serial number of the sensor is used:
+ *   # version,serial_no,intercept,we,ae,temperature,humidity,pressure
+ *   3,202310057,-112.4,0.812,-0.695,1.37,0.124,0.0571
+ * The version must be from 1 to versionMax (the largest value of the calibration field of
+ * the uplink, 0 stands for no calibration), a line with another version is skipped.
+ */
+class CalibrationModel
+{
+public:
+    static const int inputCount = 5;
+    static const long versionMax = (1L << payload_schema[PAYLOAD_calibration].bits) - 2;
+    bool load(const char * path, uint32_t serial_no);
+    bool isLoaded();
+    uint16_t version();
+    float evaluate(EnvironmentData *data);
+private:
+    bool loaded = false;
+    uint16_t modelVersion = 0;
+    float intercept = 0;
+    float coefficients[inputCount];
+    bool parseLine(char * line, uint32_t serial_no);
+};
+
+#endif
@@ -1,4 +1,4 @@
-/*
+/* 
  * ----------------------------------------------------------------------------
  * NO2 measurement with ESP32 and LoRaWan
  * https://github.com/rmh78/NO2-Measurement
@@ -7,78 +7,749 @@
 
 #include "datalogger.h"
 
-#include "FS.h"
 #include "SPIFFS.h"
 
-DataLogger::DataLogger(const char * filePath) 
+#include <rom/crc.h>
+
+static uint32_t log_crc(const void *data, size_t length)
+{
+    return crc32_le(0, (const uint8_t *) data, length);
+}
+
+static bool log_read(File &file, uint32_t index, LogRecord *record)
 {
-    path = filePath;
+    return file.seek(sizeof(LogHeader) + index * sizeof(LogRecord))
+        && file.read((uint8_t *) record, sizeof(LogRecord)) == sizeof(LogRecord)
+        && record->crc == log_crc(record, offsetof(LogRecord, crc));
 }
 
-bool DataLogger::init() 
+// the segment has a valid header of the current log version
+static bool log_valid(File &file)
 {
+    LogHeader header;
+    return file && file.seek(0) && file.read((uint8_t *) &header, sizeof(header)) == sizeof(header)
+        && header.magic == log_magic && header.crc == log_crc(&header, offsetof(LogHeader, crc))
+        && header.version == log_version && header.recordSize == sizeof(LogRecord);
+}
+
+static bool log_read_entry(File &index, uint32_t position, LogIndexEntry *entry)
+{
+    return index.seek(position * sizeof(LogIndexEntry))
+        && index.read((uint8_t *) entry, sizeof(LogIndexEntry)) == sizeof(LogIndexEntry);
+}
+
+DataLogger::DataLogger(const char * _directory, size_t _budget, int _flushRecords, unsigned long _flushInterval)
+{
+    directory = _directory;
+    budget = _budget;
+    snprintf(manifestPath, sizeof(manifestPath), "%s/manifest", directory);
+    segmentPath(path, 0, "bin");
+    segmentPath(indexPath, 0, "idx");
+    flushRecords = _flushRecords;
+    flushInterval = _flushInterval;
+}
+
+/* 
+ * Mounts the SPIFFS, loads the manifest and checks the header of the last segment,
+ * the serial number of the sensor is written into the header of a new segment
+ */
+bool DataLogger::init(uint32_t _serialNo)
+{
+    serialNo = _serialNo;
     if(!SPIFFS.begin()) 
     {
         Serial.println("(S) - SPIFFS mount failed");
         return false;
     }
 
+    loadManifest();
+    if (!openSegment(lastSegment))
+    {
+        return false;
+    }
+    closedRecords = 0;
+    for (uint32_t segment = firstSegment; segment < lastSegment; segment++)
+    {
+        closedRecords += closedCount(segment);
+    }
+    Serial.printf("(S) - SPIFFS log segments %u - %u, %u records\n", firstSegment, lastSegment, recordCount());
     return true;
 }
 
-bool DataLogger::existsFile() 
+/* 
+ * "/log/000123.bin"
+ */
+void DataLogger::segmentPath(char *name, uint32_t segment, const char *extension)
+{
+    snprintf(name, 32, "%s/%06u.%s", directory, segment, extension);
+}
+
+/* 
+ * Reads the manifest, a missing or damaged manifest is rebuilt from the names of
+ * the segment files
+ */
+void DataLogger::loadManifest()
+{
+    File file = SPIFFS.open(manifestPath);
+    LogManifest manifest;
+    bool valid = file && file.read((uint8_t *) &manifest, sizeof(manifest)) == sizeof(manifest)
+        && manifest.magic == log_manifest_magic && manifest.crc == log_crc(&manifest, offsetof(LogManifest, crc))
+        && manifest.firstSegment <= manifest.lastSegment;
+    file.close();
+
+    if (valid)
+    {
+        firstSegment = manifest.firstSegment;
+        lastSegment = manifest.lastSegment;
+    }
+    else
+    {
+        Serial.printf("(S) - SPIFFS rebuilding manifest: %s\n", manifestPath);
+        bool found = false;
+        size_t length = strlen(directory);
+        File root = SPIFFS.open("/");
+        for (File entry = root.openNextFile(); entry; entry = root.openNextFile())
+        {
+            // name() is only the base name since arduino-esp32 2.0, path() the full path
+            const char *name = entry.path();
+            unsigned segment;
+            char extension[4];
+            if (strncmp(name, directory, length) == 0 && name[length] == '/'
+                && sscanf(name + length + 1, "%u.%3s", &segment, extension) == 2 && strcmp(extension, "bin") == 0)
+            {
+                firstSegment = found && firstSegment < segment ? firstSegment : segment;
+                lastSegment = found && lastSegment > segment ? lastSegment : segment;
+                found = true;
+            }
+            entry.close();
+        }
+        root.close();
+        if (!found)
+        {
+            firstSegment = 0;
+            lastSegment = 0;
+        }
+    }
+
+    // the oldest segment is removed before the manifest is written, a reset in between leaves it missing
+    bool changed = !valid;
+    char name[32];
+    for (segmentPath(name, firstSegment, "bin"); firstSegment < lastSegment && !SPIFFS.exists(name); segmentPath(name, firstSegment, "bin"))
+    {
+        removeSegment(firstSegment);
+        firstSegment++;
+        changed = true;
+    }
+    if (changed)
+    {
+        writeManifest();
+    }
+}
+
+bool DataLogger::writeManifest()
 {
-    return SPIFFS.exists(path);
+    LogManifest manifest = { log_manifest_magic, firstSegment, lastSegment, 0 };
+    manifest.crc = log_crc(&manifest, offsetof(LogManifest, crc));
+    File file = SPIFFS.open(manifestPath, FILE_WRITE);
+    bool success = file && file.write((const uint8_t *) &manifest, sizeof(manifest)) == sizeof(manifest);
+    file.close();
+    if (!success)
+    {
+        // a damaged manifest is rebuilt at the next start
+        Serial.println("(S) - SPIFFS failed to write the manifest");
+        writeErrors++;
+    }
+    return success;
 }
 
-bool DataLogger::appendFile(const char * message) 
+/* 
+ * Makes "segment" the segment of the appended records and checks its header
+ */
+bool DataLogger::openSegment(uint32_t segment)
+{
+    segmentPath(path, segment, "bin");
+    segmentPath(indexPath, segment, "idx");
+
+    File file = SPIFFS.open(path);
+    fileSize = file ? file.size() : 0;
+    LogHeader header;
+    size_t length = file ? file.read((uint8_t *) &header, sizeof(header)) : 0;
+    bool valid = length == sizeof(header) && header.magic == log_magic
+        && header.crc == log_crc(&header, offsetof(LogHeader, crc));
+    file.close();
+
+    if (fileSize > 0 && fileSize < sizeof(LogHeader)
+        && memcmp(&header, &log_magic, length < sizeof(log_magic) ? length : sizeof(log_magic)) == 0)
+    {
+        // the header itself was torn, the segment has no records yet
+        removeSegment(segment);
+        fileSize = 0;
+    }
+    else if (fileSize > 0 && !valid)
+    {
+        Serial.printf("(S) - SPIFFS %s is not a measurement log\n", path);
+        return false;
+    }
+    else if (fileSize > 0 && (header.version != log_version || header.recordSize != sizeof(LogRecord)))
+    {
+        // the records of a new version are appended in the next segment
+        Serial.printf("(S) - SPIFFS %s has the log version %d (expected %d), starting the next segment\n", 
+            path, header.version, log_version);
+        lastSegment++;
+        writeManifest();
+        return openSegment(lastSegment);
+    }
+    loadIndex();
+    return true;
+}
+
+/* 
+ * Starts the next segment and removes the oldest segments until the new segment
+ * fits into the budget and into the free space of the SPIFFS
+ */
+void DataLogger::rotate()
 {
-    Serial.printf("(S) - SPIFFS appending to file: %s\n", path);
+    closeBlock();
+    flush();
+    writeIndex();
+    closedRecords += segmentCount();
+    lastSegment++;
+    openSegment(lastSegment);
+    writeManifest();
+    Serial.printf("(S) - SPIFFS starting segment: %s\n", path);
 
+    while (firstSegment < lastSegment
+        && ((lastSegment - firstSegment + 1) * segmentBytes > budget
+            || SPIFFS.totalBytes() - SPIFFS.usedBytes() < segmentBytes))
+    {
+        removeOldest();
+    }
+}
+
+void DataLogger::removeOldest()
+{
+    closedRecords -= closedCount(firstSegment);
+    removeSegment(firstSegment);
+    firstSegment++;
+    writeManifest();
+    removedSegments++;
+}
+
+void DataLogger::removeSegment(uint32_t segment)
+{
+    char name[32];
+    segmentPath(name, segment, "idx");
+    SPIFFS.remove(name);
+    segmentPath(name, segment, "bin");
+    Serial.printf("(S) - SPIFFS deleting segment: %s\n", name);
+    SPIFFS.remove(name);
+}
+
+bool DataLogger::append(MeasurementRecord *measurement)
+{
+    unsigned long start = micros();
+    bool success = true;
+
+    LogRecord record;
+    record.record = *measurement;
+    record.crc = log_crc(&record, offsetof(LogRecord, crc));
+
+    if (segmentCount() >= segmentRecords)
+    {
+        rotate();
+    }
+    size_t end = fileSize + buffered;
+    if (end > 0 && end < sizeof(LogHeader))
+    {
+        // the header was torn by a failed write, the segment has no records yet
+        removeSegment(lastSegment);
+        fileSize = 0;
+        indexEntries = 0;
+        entryPending = false;
+        block.records = 0;
+        end = 0;
+    }
+    if (end == 0)
+    {
+        LogHeader header;
+        memset(&header, 0xFF, sizeof(header));
+        header.magic = log_magic;
+        header.version = log_version;
+        header.recordSize = sizeof(LogRecord);
+        header.serialNo = serialNo;
+        header.crc = log_crc(&header, offsetof(LogHeader, crc));
+        success = appendBytes((const uint8_t *) &header, sizeof(header));
+    }
+    else if ((end - sizeof(LogHeader)) % sizeof(LogRecord) != 0)
+    {
+        // a torn record is padded, so it fails its CRC and the next records stay at their offsets
+        uint8_t padding[sizeof(LogRecord)];
+        memset(padding, 0xFF, sizeof(padding));
+        success = appendBytes(padding, sizeof(LogRecord) - (end - sizeof(LogHeader)) % sizeof(LogRecord));
+    }
+    uint32_t number = segmentCount();
+    success = success && appendBytes((const uint8_t *) &record, sizeof(record));
+    if (success)
+    {
+        indexRecord(number, record.record.timestamp);
+    }
+
+    if (buffered > 0 && bufferedRecords++ == 0)
+    {
+        firstBuffered = millis();
+    }
+    if (success && bufferedRecords >= flushRecords)
+    {
+        success = flush();
+    }
+    if (success && buffered == 0)
+    {
+        writeIndex();
+    }
+    if (!success && firstSegment < lastSegment)
+    {
+        // the SPIFFS may be full, the next append gets the space of the oldest segment
+        removeOldest();
+    }
+
+    unsigned long latency = micros() - start;
+    appends++;
+    totalAppendLatency += latency;
+    if (latency > maxAppendLatency)
+    {
+        maxAppendLatency = latency;
+    }
+    return success;
+}
+
+bool DataLogger::appendBytes(const uint8_t * data, int length)
+{
+    if (flushRecords <= 1)
+    {
+        return writeFile(data, length);
+    }
+
+    // fill the buffer up to the next page boundary of the file, a full page is written at once
+    bool success = true;
+    for (int position = 0; position < length && success; )
+    {
+        int limit = bufferSize - fileSize % bufferSize;
+        int n = length - position < limit - buffered ? length - position : limit - buffered;
+        memcpy(buffer + buffered, data + position, n);
+        buffered += n;
+        position += n;
+        if (buffered == limit)
+        {
+            success = flush();
+        }
+    }
+    return success;
+}
+
+/* 
+ * Writes the buffered records to the file
+ */
+bool DataLogger::flush()
+{
+    if (buffered == 0)
+    {
+        return true;
+    }
+
+    unsigned long start = micros();
+    bool success = writeFile(buffer, buffered);
+    // a failed write is not repeated, the file may hold a part of it
+    buffered = 0;
+    bufferedRecords = 0;
+    if (success)
+    {
+        writeIndex();
+    }
+
+    unsigned long latency = micros() - start;
+    flushes++;
+    totalFlushLatency += latency;
+    if (latency > maxFlushLatency)
+    {
+        maxFlushLatency = latency;
+    }
+    return success;
+}
+
+/* 
+ * Flushes the buffer if its oldest record has reached the time threshold
+ * (called periodically by the loop)
+ */
+bool DataLogger::flushIfDue()
+{
+    if (buffered > 0 && flushInterval > 0 && millis() - firstBuffered >= flushInterval)
+    {
+        return flush();
+    }
+    return true;
+}
+
+/* 
+ * Number of the last appended records which are not completely written to the file
+ */
+int DataLogger::pending()
+{
+    return bufferedRecords;
+}
+
+bool DataLogger::writeFile(const uint8_t * data, int length)
+{
     File file = SPIFFS.open(path, FILE_APPEND);
     if(!file){
         Serial.println("(S) - SPIFFS failed to open file for appending");
+        writeErrors++;
         return false;
     }
-    if(file.print(message)){
-        Serial.printf("(S) - SPIFFS message appended (file-size: %d bytes)\n", file.size());
-        file.close();
-        return true;
-    } else {
-        Serial.printf("(S) - SPIFFS append failed (file-size: %d bytes)\n", file.size());
-        file.close();
+    size_t written = file.write(data, length);
+    file.close();
+    fileSize += written;
+    if (written != (size_t) length) {
+        Serial.printf("(S) - SPIFFS append failed (file-size: %d bytes)\n", fileSize);
+        writeErrors++;
         return false;
     }
+    Serial.printf("(S) - SPIFFS %d bytes appended (file-size: %d bytes)\n", length, fileSize);
+    return true;
 }
 
-void DataLogger::readFile() 
+/* 
+ * Number of records of all segments including the damaged ones (the buffered records are counted)
+ */
+uint32_t DataLogger::recordCount()
 {
-    Serial.printf("(S) - SPIFFS reading file: %s\n", path);
+    return closedRecords + segmentCount();
+}
 
-    File file = SPIFFS.open(path);
-    if(!file){
-        Serial.println("(S) - SPIFFS failed to open file for reading");
+/* 
+ * Number of records of the last segment
+ */
+uint32_t DataLogger::segmentCount()
+{
+    size_t end = fileSize + buffered;
+    return end > sizeof(LogHeader) ? (end - sizeof(LogHeader)) / sizeof(LogRecord) : 0;
+}
+
+/* 
+ * Number of records of a segment before the last one from the size of its file
+ * (0 if it is missing or has another log version)
+ */
+uint32_t DataLogger::closedCount(uint32_t segment)
+{
+    char name[32];
+    segmentPath(name, segment, "bin");
+    File file = SPIFFS.open(name);
+    size_t size = log_valid(file) ? file.size() : 0;
+    file.close();
+    uint32_t count = size > sizeof(LogHeader) ? (size - sizeof(LogHeader)) / sizeof(LogRecord) : 0;
+    return count < segmentRecords ? count : segmentRecords;
+}
+
+/* 
+ * Reads the record "index" (0 = oldest record of the oldest segment), false if it is damaged
+ */
+bool DataLogger::readRecord(uint32_t index, LogRecord *record)
+{
+    flush();
+    if (index >= (lastSegment - firstSegment) * segmentRecords + segmentCount())
+    {
+        return false;
+    }
+    char name[32];
+    segmentPath(name, firstSegment + index / segmentRecords, "bin");
+    File file = SPIFFS.open(name);
+    bool success = log_valid(file) && log_read(file, index % segmentRecords, record);
+    file.close();
+    return success;
+}
+
+/* 
+ * Adds a record to the open block of the index. The block is closed before the record
+ * if it has indexRecords records or if the record would widen its time span to 
+ * indexSeconds (a record which goes back in time starts a new block).
+ */
+void DataLogger::indexRecord(uint32_t record, uint32_t timestamp)
+{
+    bool dated = timestamp != 0xFFFFFFFF;
+    if (block.records > 0 && dated && block.minTimestamp != 0xFFFFFFFF)
+    {
+        uint32_t minimum = timestamp < block.minTimestamp ? timestamp : block.minTimestamp;
+        uint32_t maximum = timestamp > block.maxTimestamp ? timestamp : block.maxTimestamp;
+        if (maximum - minimum >= indexSeconds)
+        {
+            closeBlock();
+        }
+    }
+    if (block.records >= (uint32_t) indexRecords)
+    {
+        closeBlock();
+    }
+    if (block.records == 0)
+    {
+        block = { 0xFFFFFFFF, 0, (uint16_t) record, 0 };
+    }
+    block.records++;
+    if (dated)
+    {
+        block.minTimestamp = timestamp < block.minTimestamp ? timestamp : block.minTimestamp;
+        block.maxTimestamp = timestamp > block.maxTimestamp ? timestamp : block.maxTimestamp;
+    }
+}
+
+/* 
+ * Makes the open block the pending entry, an entry which is still pending is written
+ * first (its records are flushed before)
+ */
+void DataLogger::closeBlock()
+{
+    if (block.records == 0)
+    {
+        return;
+    }
+    if (entryPending)
+    {
+        flush();
+        writeIndex();
+    }
+    pendingEntry = block;
+    entryPending = true;
+    block.records = 0;
+}
+
+/* 
+ * Checks the last entry of the index, a torn or stale index is rebuilt. The records after
+ * the last block are read into the open block.
+ */
+void DataLogger::loadIndex()
+{
+    indexEntries = 0;
+    entryPending = false;
+    block.records = 0;
+    File index = SPIFFS.open(indexPath);
+    size_t size = index ? index.size() : 0;
+    bool valid = size % sizeof(LogIndexEntry) == 0
+        && (size == 0 || (log_read_entry(index, size / sizeof(LogIndexEntry) - 1, &lastEntry) 
+            && lastEntry.records > 0 && lastEntry.record + lastEntry.records <= segmentCount()));
+    index.close();
+
+    if (!valid)
+    {
+        rebuildIndex();
         return;
     }
+    indexEntries = size / sizeof(LogIndexEntry);
+    indexSegment(size > 0 ? lastEntry.record + lastEntry.records : 0);
+}
 
-    Serial.println("(S) - SPIFFS read from file: ");
-    while(file.available()){
-        Serial.write(file.read());
+void DataLogger::rebuildIndex()
+{
+    Serial.printf("(S) - SPIFFS rebuilding index: %s\n", indexPath);
+    SPIFFS.remove(indexPath);
+    indexEntries = 0;
+    entryPending = false;
+    block.records = 0;
+    indexSegment(0);
+}
+
+/* 
+ * Adds the records from "first" to the end of the last segment to the index
+ * (a damaged record is in its block without a date)
+ */
+void DataLogger::indexSegment(uint32_t first)
+{
+    uint32_t count = segmentCount();
+    if (first >= count)
+    {
+        return;
+    }
+    File file = SPIFFS.open(path);
+    if (!file)
+    {
+        writeErrors++;
+        return;
+    }
+    for (uint32_t number = first; number < count; number++)
+    {
+        LogRecord record;
+        indexRecord(number, log_read(file, number, &record) ? record.record.timestamp : 0xFFFFFFFF);
+        writeIndex();
     }
     file.close();
 }
 
-void DataLogger::deleteFile()
+/* 
+ * Appends the pending entry (after its record has been written)
+ */
+bool DataLogger::writeIndex()
 {
-    Serial.printf("(S) - SPIFFS deleting file: %s\n", path);
-    if(SPIFFS.remove(path)){
-        Serial.println("(S) - SPIFFS file deleted");
-    } else {
-        Serial.println("(S) - SPIFFS delete failed");
+    if (!entryPending)
+    {
+        return true;
+    }
+    entryPending = false;
+    File index = SPIFFS.open(indexPath, FILE_APPEND);
+    bool success = index && index.write((const uint8_t *) &pendingEntry, sizeof(pendingEntry)) == sizeof(pendingEntry);
+    index.close();
+    if (!success)
+    {
+        // a torn entry is found by loadIndex at the next start
+        writeErrors++;
+        return false;
+    }
+    lastEntry = pendingEntry;
+    indexEntries++;
+    return true;
+}
+
+/* 
+ * Prints the readable records "first" to "last" (exclusive) of a segment with a timestamp 
+ * from "from" to "to" as csv, returns the number of printed records
+ */
+uint32_t DataLogger::exportRecords(File &file, uint32_t first, uint32_t last, uint32_t from, uint32_t to, uint32_t *damaged)
+{
+    uint32_t exported = 0;
+    for (uint32_t number = first; number < last; number++)
+    {
+        LogRecord record;
+        if (!log_read(file, number, &record))
+        {
+            (*damaged)++;
+            continue;
+        }
+        if (record.record.timestamp < from || record.record.timestamp > to)
+        {
+            continue;
+        }
+        EnvironmentData data;
+        record.record.unpack(&data);
+        char message[200];
+        data.logger_message(message, sizeof(message));
+        Serial.print(message);
+        exported++;
+    }
+    return exported;
+}
+
+/* 
+ * Prints all readable records of all segments as csv to the serial monitor
+ */
+void DataLogger::exportCsv()
+{
+    flush();
+    Serial.printf("(S) - SPIFFS exporting log: %s, segments %u - %u\n", directory, firstSegment, lastSegment);
+    Serial.println("date,time,latitude,longitude,temperature,humidity,pressure,ae,we,ppb,we_stddev,ae_stddev,o3,co,ugm3,calibration,samples,we_min,we_max");
+
+    uint32_t exported = 0;
+    uint32_t damaged = 0;
+    for (uint32_t segment = firstSegment; segment <= lastSegment; segment++)
+    {
+        char name[32];
+        segmentPath(name, segment, "bin");
+        File file = SPIFFS.open(name);
+        if(!log_valid(file)){
+            Serial.printf("(S) - SPIFFS skipping segment (missing or other log version): %s\n", name);
+            file.close();
+            continue;
+        }
+        exported += exportRecords(file, 0, segment == lastSegment ? segmentCount() : segmentRecords, 0, 0xFFFFFFFF, &damaged);
+        file.close();
+    }
+    Serial.printf("(S) - SPIFFS exported %u records, %u damaged records skipped\n", exported, damaged);
+}
+
+/* 
+ * Prints the records with a timestamp from "from" to "to" (seconds since payload_epoch) 
+ * as csv, only the blocks of the index which overlap the range and the records which are
+ * in no block are read (records without a date are in no range)
+ */
+void DataLogger::readRange(uint32_t from, uint32_t to)
+{
+    flush();
+    to = to < 0xFFFFFFFF ? to : 0xFFFFFFFE;
+
+    uint32_t exported = 0;
+    uint32_t damaged = 0;
+    Serial.println("date,time,latitude,longitude,temperature,humidity,pressure,ae,we,ppb,we_stddev,ae_stddev,o3,co,ugm3,calibration,samples,we_min,we_max");
+    for (uint32_t segment = firstSegment; segment <= lastSegment; segment++)
+    {
+        char name[32];
+        segmentPath(name, segment, "bin");
+        File file = SPIFFS.open(name);
+        if(!log_valid(file)){
+            Serial.printf("(S) - SPIFFS skipping segment (missing or other log version): %s\n", name);
+            file.close();
+            continue;
+        }
+        uint32_t count = segment == lastSegment ? segmentCount() : segmentRecords;
+        segmentPath(name, segment, "idx");
+        File index = SPIFFS.open(name);
+        uint32_t entries = index ? index.size() / sizeof(LogIndexEntry) : 0;
+
+        // "next" is the first record after the blocks which are done, the entry after
+        // the last one is an empty block at the end of the segment
+        uint32_t next = 0;
+        uint32_t read = 0;
+        for (uint32_t position = 0; position <= entries; position++)
+        {
+            LogIndexEntry entry = { 0xFFFFFFFF, 0, (uint16_t) count, 0 };
+            if (position < entries && !log_read_entry(index, position, &entry))
+            {
+                entry = { 0xFFFFFFFF, 0, (uint16_t) count, 0 };
+            }
+            uint32_t start = entry.record < count ? entry.record : count;
+            uint32_t end = entry.record + entry.records < count ? entry.record + entry.records : count;
+            if (next < start)
+            {
+                exported += exportRecords(file, next, start, from, to, &damaged);
+                read += start - next;
+            }
+            if (entry.records > 0 && entry.minTimestamp <= to && entry.maxTimestamp >= from)
+            {
+                exported += exportRecords(file, start, end, from, to, &damaged);
+                read += end - start;
+            }
+            next = end > next ? end : next;
+        }
+        index.close();
+        file.close();
+        Serial.printf("(S) - SPIFFS read %u of %u records of segment %u\n", read, count, segment);
+    }
+    Serial.printf("(S) - SPIFFS exported %u records, %u damaged records skipped\n", exported, damaged);
+}
+
+/* 
+ * Removes all segments and the manifest, the next record starts segment 0
+ */
+void DataLogger::deleteLog()
+{
+    Serial.printf("(S) - SPIFFS deleting log: %s\n", directory);
+    buffered = 0;
+    bufferedRecords = 0;
+    for (uint32_t segment = firstSegment; segment <= lastSegment; segment++)
+    {
+        removeSegment(segment);
     }
+    SPIFFS.remove(manifestPath);
+    firstSegment = 0;
+    lastSegment = 0;
+    closedRecords = 0;
+    openSegment(0);
+    Serial.println("(S) - SPIFFS log deleted");
 }
 
 void DataLogger::printInfo() 
 {
     Serial.printf("(S) - SPIFFS memory used/total bytes: %d/%d\n", SPIFFS.usedBytes(), SPIFFS.totalBytes());
+    Serial.printf("(S) - SPIFFS segments: %u - %u, removed: %u, budget: %u bytes\n",
+        firstSegment, lastSegment, removedSegments, budget);
+    Serial.printf("(S) - SPIFFS file-size: %d bytes, records: %u, index entries: %u, buffered: %d bytes/%d records, write errors: %u\n",
+        fileSize, recordCount(), indexEntries, buffered, bufferedRecords, writeErrors);
+    unsigned long averageAppend = appends > 0 ? totalAppendLatency / appends : 0;
+    unsigned long averageFlush = flushes > 0 ? totalFlushLatency / flushes : 0;
+    Serial.printf("(S) - SPIFFS appends: %u, latency avg/max: %lu/%lu us, flushes: %u, latency avg/max: %lu/%lu us\n", 
+        appends, averageAppend, maxAppendLatency, flushes, averageFlush, maxFlushLatency);
 }
\ No newline at end of file
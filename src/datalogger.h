@@ -3,34 +3,176 @@
  * NO2 measurement with ESP32 and LoRaWan
  * https://github.com/rmh78/NO2-Measurement
  * ----------------------------------------------------------------------------
+ *
+ * Binary measurement log on the flash storage (SPIFFS) in segment files:
+ *   <directory>/000123.bin  segment with segmentRecords records
+ *   <directory>/000123.idx  sparse index of the segment
+ *   <directory>/manifest    first and last segment number and their CRC32
+ *
+ * Segment file:
+ *   header   32 bytes  magic "NO2L", version of the record layout (log_version), record
+ *                      size, serial number of the NO2 sensor and the CRC32 of the header
+ *   records  44 bytes  MeasurementRecord of the queue (see record.h) and its CRC32
+ * Record n of the log (0 = first record of the oldest segment) is the record 
+ * n % segmentRecords of the segment firstSegment + n / segmentRecords at the offset
+ * sizeof(LogHeader) + (n % segmentRecords) * sizeof(LogRecord), so it is read without 
+ * scanning (a segment which was closed before it was full leaves a gap in the numbers, 
+ * recordCount counts only the records in the files). A record with a wrong CRC (torn write at a power loss) is skipped. A torn 
+ * record at the end of a segment is padded at the next start, so the following records 
+ * stay at their offsets. The records of a new log version start a new segment, the 
+ * segments of other versions are skipped. exportCsv prints the log as csv.
+ *
+ * A full segment is closed and the next one is started, so no file grows without bound.
+ * When the segments exceed the byte budget or the SPIFFS has no room for another segment,
+ * the oldest segment is removed (no file is rewritten). The manifest is rebuilt from the
+ * segment files if it is missing or damaged.
+ *
+ * The sparse index of a segment holds one entry per block of records: the first record
+ * and the number of records of the block and the smallest and the largest timestamp of
+ * its records. A block is closed after indexRecords records or when a record would widen
+ * its time span to indexSeconds, so the records of the queue which are logged again after
+ * a downsampling (they go back in time) start a block of their own. readRange reads only
+ * the blocks which overlap the time range (and the records which are in no block, e.g. the
+ * open block of the last segment). The entry of a block is written after its records. The
+ * index is rebuilt from the segment if it is missing or damaged.
  */
 
 #ifndef _datalogger_h_
 #define _datalogger_h_
 
+#include <Arduino.h>
+#include "FS.h"
+
+#include "record.h"
+
 #ifdef __cplusplus
 extern "C"{
 #endif
 
-/* 
- * This class is responsible for handling the access to one file on the flash storage (SPIFFS)
+const uint32_t log_magic = 0x4C324F4E; // "NO2L"
+const uint32_t log_manifest_magic = 0x4D324F4E; // "NO2M"
+const uint16_t log_version = 6;
+
+struct LogHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t recordSize;
+    uint32_t serialNo;
+    uint8_t reserved[16];
+    uint32_t crc;
+};
+
+struct LogRecord
+{
+    MeasurementRecord record;
+    uint32_t crc;
+};
+
+struct LogIndexEntry
+{
+    uint32_t minTimestamp;   // 0xFFFFFFFF if no record of the block has a date
+    uint32_t maxTimestamp;
+    uint16_t record;
+    uint16_t records;
+};
+
+struct LogManifest
+{
+    uint32_t magic;
+    uint32_t firstSegment;
+    uint32_t lastSegment;
+    uint32_t crc;
+};
+
+static_assert(sizeof(LogHeader) == 32, "LogHeader must stay 32 bytes");
+static_assert(sizeof(LogRecord) == 44, "LogRecord must stay 44 bytes");
+static_assert(sizeof(LogIndexEntry) == 12, "LogIndexEntry must stay 12 bytes");
+
+/*
+ * This class is responsible for handling the access to the log files on the flash storage (SPIFFS)
+ *
+ * With flushRecords > 1 the logger writes behind: the records are collected in a buffer
+ * of one SPIFFS page and the file is opened once per flush instead of once per record
+ * (every open of a growing file scans its page index). The buffer is flushed when it
+ * reaches the end of a page of the file (so only full pages are written), when it holds
+ * flushRecords records (a page holds about 6 records, a larger flushRecords never 
+ * triggers), when the oldest record is flushInterval ms old (flushIfDue)
+ * or by flush(). The buffered records are lost on a reset, so pending() tells how many
+ * of the appended records are not completely in the file yet (the caller keeps them).
  */
 class DataLogger
 {
-private:
-    const char * path;
 public:
-    DataLogger(const char * filePath);
-    bool init();
-    bool existsFile();
-    bool appendFile(const char * message);
-    void readFile();
-    void deleteFile();
+    static const int bufferSize = 256;   // SPIFFS page size of the arduino-esp32 partition
+    static const int indexRecords = 64;
+    static const uint32_t indexSeconds = 3600;
+    static const uint32_t segmentRecords = 1024;   // 44 kB per segment
+    static const size_t segmentBytes = sizeof(LogHeader) + segmentRecords * sizeof(LogRecord);
+    DataLogger(const char * _directory, size_t _budget, int _flushRecords = 1, unsigned long _flushInterval = 0);
+    bool init(uint32_t _serialNo = 0);
+    bool append(MeasurementRecord *measurement);
+    bool flush();
+    bool flushIfDue();
+    int pending();
+    uint32_t recordCount();
+    bool readRecord(uint32_t number, LogRecord *record);
+    void exportCsv();
+    void readRange(uint32_t from, uint32_t to);
+    void deleteLog();
     void printInfo();
+private:
+    const char * directory;
+    size_t budget;                   // bytes of all segments
+    uint32_t firstSegment = 0;
+    uint32_t lastSegment = 0;
+    uint32_t closedRecords = 0;      // records of the segments before the last one
+    char path[32];                   // segment and index of the last segment
+    char indexPath[32];
+    char manifestPath[32];
+    uint32_t serialNo = 0;
+    int flushRecords;
+    unsigned long flushInterval;     // ms, 0 = no time threshold
+    uint8_t buffer[bufferSize];
+    int buffered = 0;
+    int bufferedRecords = 0;
+    unsigned long firstBuffered = 0; // millis
+    size_t fileSize = 0;
+    uint32_t appends = 0;
+    uint32_t flushes = 0;
+    uint32_t writeErrors = 0;
+    uint32_t removedSegments = 0;
+    unsigned long maxAppendLatency = 0;   // micros
+    unsigned long totalAppendLatency = 0; // micros
+    unsigned long maxFlushLatency = 0;    // micros
+    unsigned long totalFlushLatency = 0;  // micros
+    uint32_t indexEntries = 0;
+    LogIndexEntry lastEntry;
+    LogIndexEntry block;             // open block of the last segment (not in the index yet)
+    LogIndexEntry pendingEntry;
+    bool entryPending = false;
+    void segmentPath(char *name, uint32_t segment, const char *extension);
+    void loadManifest();
+    bool writeManifest();
+    bool openSegment(uint32_t segment);
+    void rotate();
+    void removeOldest();
+    void removeSegment(uint32_t segment);
+    uint32_t segmentCount();
+    uint32_t closedCount(uint32_t segment);
+    bool appendBytes(const uint8_t * data, int length);
+    bool writeFile(const uint8_t * data, int length);
+    void indexRecord(uint32_t record, uint32_t timestamp);
+    void closeBlock();
+    void loadIndex();
+    void rebuildIndex();
+    void indexSegment(uint32_t first);
+    bool writeIndex();
+    uint32_t exportRecords(File &file, uint32_t first, uint32_t last, uint32_t from, uint32_t to, uint32_t *damaged);
 };
 
 #ifdef __cplusplus
 } // extern "C"
 #endif
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,139 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "gps.h"
+#include "nmea.h"
+
+#include <driver/uart.h>
+
+// GPS task (runs on core 0, it is woken up by the UART events only)
+const int gpsCore = 0;
+const int gpsPriority = 2;
+const int gpsStackSize = 4096;
+const int gpsChunkSize = 128;
+
+static NMEAParser nmea;
+
+void GPSReceiver::begin(int _uart, int baud, int rxPin, int txPin)
+{
+    uart = _uart;
+
+    uart_config_t config = {};
+    config.baud_rate = baud;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_1;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    uart_param_config((uart_port_t) uart, &config);
+    uart_set_pin((uart_port_t) uart, txPin, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    uart_driver_install((uart_port_t) uart, ringBufferSize, 0, eventQueueLength, &eventQueue, 0);
+
+    xTaskCreatePinnedToCore(receiveTask, "gps", gpsStackSize, this, gpsPriority, NULL, gpsCore);
+}
+
+/* 
+ * Latest fix (NULL if there is none yet), it stays valid until the next call
+ * (only called by the measurement)
+ */
+const GPSFix *GPSReceiver::latest()
+{
+    // the older fixes are handed back to the GPS task, the latest one is kept 
+    // so it is available again if no new fix has arrived until the next call
+    int count = fixes.count();
+    if (count > 1)
+    {
+        fixes.ack(count - 1);
+    }
+    return fixes.peek(0);
+}
+
+uint32_t GPSReceiver::overflows()
+{
+    return overflowCount;
+}
+
+uint32_t GPSReceiver::droppedFixes()
+{
+    return droppedCount;
+}
+
+uint32_t GPSReceiver::checksumErrors()
+{
+    return nmea.checksumErrors();
+}
+
+void GPSReceiver::receiveTask(void *parameter)
+{
+    GPSReceiver *receiver = (GPSReceiver *) parameter;
+    for (;;)
+    {
+        receiver->receive();
+    }
+}
+
+void GPSReceiver::receive()
+{
+    uart_event_t event;
+    if (!xQueueReceive(eventQueue, &event, portMAX_DELAY))
+    {
+        return;
+    }
+
+    switch (event.type)
+    {
+        case UART_DATA:
+        {
+            uint8_t chunk[gpsChunkSize];
+            size_t buffered = 0;
+            uart_get_buffered_data_len((uart_port_t) uart, &buffered);
+            while (buffered > 0)
+            {
+                int length = uart_read_bytes((uart_port_t) uart, chunk, 
+                    buffered < sizeof(chunk) ? buffered : sizeof(chunk), 0);
+                if (length <= 0)
+                {
+                    break;
+                }
+                parse(chunk, length);
+                buffered -= length;
+            }
+            break;
+        }
+
+        case UART_FIFO_OVF:
+        case UART_BUFFER_FULL:
+            // the ring buffer can not be drained fast enough - start over with the next sentence
+            overflowCount++;
+            uart_flush_input((uart_port_t) uart);
+            xQueueReset(eventQueue);
+            break;
+
+        default:
+            break;
+    }
+}
+
+void GPSReceiver::parse(const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        // a complete RMC or GGA sentence was applied to the fix - publish it
+        // (the ring only runs full if the loop has not taken the fixes for some seconds)
+        if (nmea.encode(data[i], &fix))
+        {
+            fix.timestamp = millis();
+            GPSFix *slot = fixes.acquire();
+            if (slot == NULL)
+            {
+                droppedCount++;
+                continue;
+            }
+            *slot = fix;
+            fixes.commit();
+        }
+    }
+}
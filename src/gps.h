@@ -0,0 +1,68 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _gps_h_
+#define _gps_h_
+
+#include <Arduino.h>
+
+#include "spscring.h"
+
+/* 
+ * This class holds the latest position and UTC date/time of the GPS receiver
+ */
+class GPSFix
+{
+public:
+    bool dateTimeValid = false;
+    bool locationValid = false;
+    uint16_t year = 0;
+    uint8_t month = 0;
+    uint8_t day = 0;
+    uint8_t hour = 0;
+    uint8_t minute = 0;
+    uint8_t second = 0;
+    int32_t latitude = 0;   // micro degrees
+    int32_t longitude = 0;  // micro degrees
+    int32_t altitude = 0;   // cm
+    uint32_t satellites = 0;
+    uint16_t course = 0;    // 1/100 degree
+    uint32_t speed = 0;     // 1/100 knots
+    unsigned long timestamp = 0;
+};
+
+/* 
+ * This class reads the NMEA sentences of the GPS module (NEO-6M, 9600 baud) in its own task.
+ * The UART driver fills a large ring buffer from its interrupt, the task wakes up on the 
+ * UART events and parses the bytes continuously (RMC and GGA only, see nmea.h), so no 
+ * sentence is lost while the loop is busy. The fixes are handed over in place through a 
+ * wait-free ring, the measurement only takes the latest one.
+ */
+class GPSReceiver
+{
+public:
+    static const int ringBufferSize = 2048;
+    static const int eventQueueLength = 16;
+    static const int fixRingSize = 16;       // fixes of about 8 seconds (RMC and GGA each second)
+    void begin(int _uart, int baud, int rxPin, int txPin);
+    const GPSFix *latest();
+    uint32_t overflows();
+    uint32_t droppedFixes();
+    uint32_t checksumErrors();
+private:
+    int uart;
+    QueueHandle_t eventQueue;
+    SPSCRing<GPSFix, fixRingSize> fixes;
+    uint32_t overflowCount = 0;
+    uint32_t droppedCount = 0;
+    GPSFix fix;
+    static void receiveTask(void *parameter);
+    void receive();
+    void parse(const uint8_t *data, int length);
+};
+
+#endif
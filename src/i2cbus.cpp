@@ -0,0 +1,245 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "i2cbus.h"
+
+#include <Wire.h>
+
+// bus task (runs on core 0 next to the acquisition task, with a higher priority),
+// the stack holds the Serial.printf of the bus recovery
+const int busCore = 0;
+const int busPriority = 2;
+const int busStackSize = 4096;
+const int replyQueueLength = 2;
+
+I2CBus i2cBus;
+
+void I2CBus::begin(int _sda, int _scl)
+{
+    sda = _sda;
+    scl = _scl;
+    Wire.begin(sda, scl);
+    Wire.setTimeOut(busTimeout);
+
+    transactionQueue = xQueueCreate(queueLength, sizeof(I2CTransaction));
+    xTaskCreatePinnedToCore(busTask, "i2cbus", busStackSize, this, busPriority, NULL, busCore);
+}
+
+bool I2CBus::submit(I2CTransaction &transaction)
+{
+    transaction.submitted = micros();
+    TickType_t remaining = transaction.deadline - xTaskGetTickCount();
+    if ((int32_t) remaining <= 0)
+    {
+        return false;
+    }
+    return xQueueSend(transactionQueue, &transaction, remaining);
+}
+
+uint32_t I2CBus::recoveries()
+{
+    return recoveryCount;
+}
+
+void I2CBus::busTask(void *parameter)
+{
+    I2CBus *bus = (I2CBus *) parameter;
+    I2CTransaction transaction;
+    for (;;)
+    {
+        if (xQueueReceive(bus->transactionQueue, &transaction, portMAX_DELAY))
+        {
+            bus->execute(transaction);
+            xQueueSend(transaction.replyQueue, &transaction, 0);
+        }
+    }
+}
+
+void I2CBus::execute(I2CTransaction &transaction)
+{
+    I2CDeviceStats *device = deviceStats(transaction.address);
+
+    // the caller has already given up - do not touch the bus
+    if ((int32_t) (transaction.deadline - xTaskGetTickCount()) < 0)
+    {
+        transaction.status = I2C_TIMEOUT;
+        if (device)
+        {
+            device->timeouts++;
+        }
+        return;
+    }
+
+    Wire.beginTransmission(transaction.address);
+    Wire.write(transaction.data, transaction.writeLength);
+    uint8_t result = Wire.endTransmission();
+    if (result == 0 && transaction.readLength > 0)
+    {
+        uint8_t received = Wire.requestFrom(transaction.address, transaction.readLength);
+        for (int i = 0; i < received; i++)
+        {
+            transaction.data[i] = Wire.read();
+        }
+        // requestFrom returns 0 when the device did not acknowledge its read address
+        transaction.status = received == transaction.readLength ? I2C_OK 
+            : received == 0 ? I2C_NACK : I2C_SHORT_READ;
+    }
+    else if (result == 0)
+    {
+        transaction.status = I2C_OK;
+    }
+    else if (result == 2 || result == 3)
+    {
+        transaction.status = I2C_NACK;
+    }
+    else
+    {
+        transaction.status = I2C_BUS_ERROR;
+    }
+
+    // a NACK is a normal answer (e.g. no new SHT31 measurement), everything else 
+    // counts towards the recovery of the bus
+    if (transaction.status == I2C_OK || transaction.status == I2C_NACK)
+    {
+        consecutiveErrors = 0;
+    }
+    else if (transaction.status == I2C_BUS_ERROR || ++consecutiveErrors >= recoveryThreshold)
+    {
+        recover();
+    }
+
+    if (device)
+    {
+        unsigned long latency = micros() - transaction.submitted;
+        device->transactions++;
+        device->totalLatency += latency;
+        if (latency > device->maxLatency)
+        {
+            device->maxLatency = latency;
+        }
+        if (transaction.status != I2C_OK)
+        {
+            device->errors++;
+        }
+    }
+}
+
+void I2CBus::recover()
+{
+    // a slave which was interrupted in the middle of a byte holds SDA low, 
+    // up to 9 clock pulses let it finish the byte, then a STOP releases the bus
+    recoveryCount++;
+    consecutiveErrors = 0;
+    Serial.printf("***** I2C bus recovery %d ******\n", recoveryCount);
+
+    // the driver releases the pins first, otherwise they stay attached to the I2C peripheral
+    Wire.end();
+    pinMode(sda, INPUT_PULLUP);
+    pinMode(scl, OUTPUT_OPEN_DRAIN);
+    for (int i = 0; i < 9 && digitalRead(sda) == LOW; i++)
+    {
+        digitalWrite(scl, LOW);
+        delayMicroseconds(5);
+        digitalWrite(scl, HIGH);
+        delayMicroseconds(5);
+    }
+
+    // STOP condition: SDA rises while SCL is high
+    pinMode(sda, OUTPUT_OPEN_DRAIN);
+    digitalWrite(sda, LOW);
+    delayMicroseconds(5);
+    digitalWrite(scl, HIGH);
+    delayMicroseconds(5);
+    digitalWrite(sda, HIGH);
+    delayMicroseconds(5);
+
+    Wire.begin(sda, scl);
+    Wire.setTimeOut(busTimeout);
+}
+
+I2CDeviceStats *I2CBus::deviceStats(uint8_t address)
+{
+    for (int i = 0; i < deviceCount; i++)
+    {
+        if (stats[i].address == address)
+        {
+            return &stats[i];
+        }
+    }
+    if (deviceCount >= maxDevices)
+    {
+        return NULL;
+    }
+    stats[deviceCount].address = address;
+    return &stats[deviceCount++];
+}
+
+void I2CBus::printInfo()
+{
+    Serial.printf("(M) - I2C - recoveries: %d\n", recoveryCount);
+    for (int i = 0; i < deviceCount; i++)
+    {
+        I2CDeviceStats &device = stats[i];
+        unsigned long averageLatency = device.transactions > 0 ? device.totalLatency / device.transactions : 0;
+        Serial.printf("(M) - I2C - device 0x%02x - transactions: %u, errors: %u, timeouts: %u, latency avg/max: %lu/%lu us\n",
+            device.address, device.transactions, device.errors, device.timeouts, averageLatency, device.maxLatency);
+    }
+}
+
+I2CStatus I2CClient::write(uint8_t address, const uint8_t *data, uint8_t length, int timeout)
+{
+    return writeRead(address, data, length, NULL, 0, timeout);
+}
+
+I2CStatus I2CClient::writeRead(uint8_t address, const uint8_t *data, uint8_t length, 
+    uint8_t *buffer, uint8_t readLength, int timeout)
+{
+    if (length > I2CTransaction::maxLength || readLength > I2CTransaction::maxLength)
+    {
+        return I2C_BUS_ERROR;
+    }
+    if (replyQueue == NULL)
+    {
+        replyQueue = xQueueCreate(replyQueueLength, sizeof(I2CTransaction));
+    }
+
+    I2CTransaction transaction;
+    transaction.id = ++nextId;
+    transaction.address = address;
+    transaction.writeLength = length;
+    transaction.readLength = readLength;
+    memcpy(transaction.data, data, length);
+    transaction.deadline = xTaskGetTickCount() + pdMS_TO_TICKS(timeout);
+    transaction.replyQueue = replyQueue;
+    if (!i2cBus.submit(transaction))
+    {
+        return I2C_TIMEOUT;
+    }
+
+    // wait for the reply of this transaction (the deadline plus the hardware timeout
+    // of the bus), replies of transactions which timed out earlier are dropped
+    TickType_t replyDeadline = transaction.deadline + pdMS_TO_TICKS(I2CBus::busTimeout);
+    I2CTransaction reply;
+    for (;;)
+    {
+        TickType_t remaining = replyDeadline - xTaskGetTickCount();
+        if ((int32_t) remaining <= 0 || !xQueueReceive(replyQueue, &reply, remaining))
+        {
+            return I2C_TIMEOUT;
+        }
+        if (reply.id == transaction.id)
+        {
+            break;
+        }
+    }
+
+    if (reply.status == I2C_OK && readLength > 0)
+    {
+        memcpy(buffer, reply.data, readLength);
+    }
+    return reply.status;
+}
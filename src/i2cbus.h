@@ -0,0 +1,105 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _i2cbus_h_
+#define _i2cbus_h_
+
+#include <Arduino.h>
+
+enum I2CStatus
+{
+    I2C_OK,
+    I2C_NACK,       // device did not acknowledge (absent or busy)
+    I2C_SHORT_READ, // less bytes received than requested
+    I2C_BUS_ERROR,  // bus busy or hardware timeout (triggers the bus recovery)
+    I2C_TIMEOUT     // deadline expired before the transaction was executed
+};
+
+/* 
+ * One I2C transaction: write the bytes to the device and optionally read 
+ * bytes back. The buffers are part of the transaction,
+ * so it is passed by value through the queues of the bus task.
+ */
+class I2CTransaction
+{
+public:
+    static const int maxLength = 8;
+    uint32_t id = 0;
+    uint8_t address = 0;
+    uint8_t writeLength = 0;
+    uint8_t readLength = 0;
+    uint8_t data[maxLength];
+    I2CStatus status = I2C_OK;
+    unsigned long submitted = 0; // micros
+    TickType_t deadline = 0;
+    QueueHandle_t replyQueue = NULL;
+};
+
+/* 
+ * Latency and error counters of one device on the bus
+ */
+class I2CDeviceStats
+{
+public:
+    uint8_t address = 0;
+    uint32_t transactions = 0;
+    uint32_t errors = 0;
+    uint32_t timeouts = 0;
+    unsigned long maxLatency = 0;   // micros
+    unsigned long totalLatency = 0; // micros
+};
+
+/* 
+ * This class owns the Wire interface. All drivers (SHT31, BMP180, ADS1115) hand their
+ * transactions to the bus task through one queue, so the transactions are serialized 
+ * without a shared mutex. A transaction which is not executed before its deadline is 
+ * dropped, and a stuck bus (a slave holding SDA low) is cleared with 9 clock pulses.
+ */
+class I2CBus
+{
+public:
+    static const int queueLength = 8;
+    static const int maxDevices = 8;
+    static const int busTimeout = 50;         // ms, hardware timeout of one transaction
+    static const int recoveryThreshold = 3;   // consecutive errors which trigger a recovery
+    void begin(int _sda, int _scl);
+    bool submit(I2CTransaction &transaction);
+    uint32_t recoveries();
+    void printInfo();
+private:
+    int sda;
+    int scl;
+    QueueHandle_t transactionQueue;
+    I2CDeviceStats stats[maxDevices];
+    int deviceCount = 0;
+    int consecutiveErrors = 0;
+    uint32_t recoveryCount = 0;
+    static void busTask(void *parameter);
+    void execute(I2CTransaction &transaction);
+    void recover();
+    I2CDeviceStats *deviceStats(uint8_t address);
+};
+
+/* 
+ * Access to the bus for one driver. Each client has its own reply queue and 
+ * must only be used by one task.
+ */
+class I2CClient
+{
+public:
+    static const int defaultTimeout = 100; // ms
+    I2CStatus write(uint8_t address, const uint8_t *data, uint8_t length, int timeout = defaultTimeout);
+    I2CStatus writeRead(uint8_t address, const uint8_t *data, uint8_t length, 
+        uint8_t *buffer, uint8_t readLength, int timeout = defaultTimeout);
+private:
+    QueueHandle_t replyQueue = NULL;
+    uint32_t nextId = 0;
+};
+
+extern I2CBus i2cBus;
+
+#endif
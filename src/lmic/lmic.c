@@ -2358,6 +2358,38 @@ int LMIC_setTxData2 (uint8_t port, uint8_t *data, uint8_t dlen, uint8_t confirme
     return 0;
 }
 
+// Maximum application payload for the current datarate (without piggybacked MAC options)
+int LMIC_maxPayloadLen (void) {
+    int flen = maxFrameLen(LMIC.datarate);
+    if( flen > MAX_LEN_FRAME )
+        flen = MAX_LEN_FRAME;
+    return flen - OFF_DAT_OPTS - 5;
+}
+
+// Airtime of an uplink with dlen bytes of application payload at the current datarate
+ostime_t LMIC_airTime (uint8_t dlen) {
+    return calcAirTime(updr2rps(LMIC.datarate), dlen + OFF_DAT_OPTS + 5);
+}
+
+// Duty cycle 1/txcap of the uplinks at the current datarate (most permissive band
+// of the enabled channels), 0 = no duty cycle limitation
+uint16_t LMIC_txCap (void) {
+#if defined(LMIC_EU686)
+    uint16_t txcap = 0;
+    for( uint8_t chnl=0; chnl<MAX_CHANNELS; chnl++ ) {
+        if( (LMIC.channelMap & (1<<chnl)) != 0  &&
+            (LMIC.channelDrMap[chnl] & (1<<(LMIC.datarate&0xF))) != 0 ) {
+            uint16_t cap = LMIC.bands[LMIC.channelFreq[chnl] & 0x3].txcap;
+            if( txcap == 0 || cap < txcap )
+                txcap = cap;
+        }
+    }
+    return txcap;
+#else
+    return 0;
+#endif
+}
+
 
 // Send a payload-less message to signal device is alive
 void LMIC_sendAlive (void) {
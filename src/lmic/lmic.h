@@ -307,6 +307,9 @@ void  LMIC_reset        (void);
 void  LMIC_clrTxData    (void);
 void  LMIC_setTxData    (void);
 int   LMIC_setTxData2   (uint8_t port, uint8_t *data, uint8_t dlen, uint8_t confirmed);
+int   LMIC_maxPayloadLen (void);
+ostime_t LMIC_airTime   (uint8_t dlen);
+uint16_t LMIC_txCap     (void);
 void  LMIC_sendAlive    (void);
 
 #if !defined(LMIC_DISABLE_BEACONS)
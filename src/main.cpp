@@ -9,8 +9,8 @@
  * 
  * There are four distinct modes which can be enabled
  * - "normal mode" (non of the defines are enabled) - first measurement then sending data
- * - OFFLINE_WRITE_MODE - first measurement then logging data into csv-file on the flash memory
- * - OFFLINE_READ_MODE - reading the csv-file and print to the serial monitor
+ * - OFFLINE_WRITE_MODE - first measurement then logging data into a binary log on the flash memory
+ * - OFFLINE_READ_MODE - reading the log and print it as csv to the serial monitor
  * - TOGGLE_MODE - only measurement unless the button is pressed which causes sending all stored messages
  */
 
@@ -22,6 +22,10 @@
 
 #include "measurement.h"
 #include "datalogger.h"
+#include "payload.h"
+#include "record.h"
+#include "persistentqueue.h"
+#include "uplink.h"
 #include "lorawan-node.h"
 
 /*
@@ -38,9 +42,12 @@
 //#define OFFLINE_WRITE_MODE
 
 /* OFFLINE_READ_MODE read the content of the file on the flash-memory 
- * and displays it on the serial monitor
+ * and displays it as csv on the serial monitor
+ * (only the time range OFFLINE_READ_FROM - OFFLINE_READ_TO in unix time if defined)
  */
 //#define OFFLINE_READ_MODE
+//#define OFFLINE_READ_FROM 1517875200
+//#define OFFLINE_READ_TO   1517961599
 
 /* LMIC callback methods to get the ids. 
  * The APPEUI, DEVEUI and APPKEY are defined in the file lorawan-node.h
@@ -63,9 +70,22 @@ const lmic_pinmap lmic_pins = {
 static osjob_t sendjob;
 
 /* Queue to store the measurement data
+ * The measurements are queued as compact records (see record.h) on the flash partition
+ * "queue" (see partitions.csv), so they survive a reset or brown-out. The 256 KB 
+ * partition holds 5185 measurements (about 36 days).
  */
-QueueHandle_t xQueue;
-const TickType_t xTicksToWait = pdMS_TO_TICKS(100);
+PersistentQueue queue;
+const char * queuePartition = "queue";
+
+/* Batch of queued measurements which is currently sent
+ * The oldest records of the queue are read into the batch and are only removed
+ * from the queue when the uplink was acknowledged (see payload.h). The batch is 
+ * read again when the queue has removed records itself (see PersistentQueue::generation).
+ */
+EnvironmentData batch[payload_batch_max];
+int batchCount = 0;
+int batchSent = 0;
+uint32_t batchGeneration = 0;
 
 /* Measurement variables
  * The wait periods for measurement and sending are defined here
@@ -93,14 +113,23 @@ static int oldButtonState = HIGH;
 static bool toggleOn = false;
 
 /* Data logger
- * Used to store the measurement data into a csv on the onboard flash memory
+ * Used to store the measurement data into a binary log on the onboard flash memory,
+ * written behind in pages (at the latest 30 minutes after the measurement), the oldest
+ * segments of the log are removed above 768 kB. A page holds about 6 records, so it is
+ * written before the 16 records of the count threshold are reached (the threshold only
+ * turns on the write-behind, the page and the 30 minutes decide when a record is written). The logged records are removed from the
+ * queue when they are in the file (loggedRecords: oldest records of the queue which 
+ * are appended, but not removed yet).
  */
-DataLogger dataLogger = DataLogger("/no2-data.csv");
+DataLogger dataLogger = DataLogger("/log", 768 * 1024, 16, 30 * 60 * 1000UL);
+int loggedRecords = 0;
+uint32_t loggedGeneration = 0;
 
 /* Prototypes */
 void initOled();
 bool initDataLoggerWrite();
 void initDataLoggerRead();
+void removeLogged(bool success);
 void initButton();
 void initLed();
 void initQueue();
@@ -112,6 +141,8 @@ void messageSent(bool removeFromQueue);
 void displayGPS(EnvironmentData *data);
 void displayData(EnvironmentData *data);
 void displayQueue();
+int fillBatch();
+int queuedMessages();
 
 void setup() {
     Serial.begin(115200);
@@ -128,15 +159,15 @@ void setup() {
         return; 
     #endif
 
+    no2.init();
+    u8x8.println("sensors - ok");
+
     #ifdef OFFLINE_WRITE_MODE
         if (!initDataLoggerWrite()) {
             return;
         }
     #endif
 
-    no2.init();
-    u8x8.println("sensors - ok");
-
     #ifdef TOGGLE_MODE
         initButton();
     #endif
@@ -160,6 +191,7 @@ void loop()
 {
     // Let LMIC handle background tasks
     os_runloop_once();
+    no2.releaseGPSFixes();
 }
 
 void initOled() 
@@ -180,15 +212,9 @@ void initOled()
 bool initDataLoggerWrite() 
 {
     Serial.println("(I) - init data-logger");
-    if (dataLogger.init()) 
+    if (dataLogger.init(no2.serialNo())) 
     {
         u8x8.println("logger - ok");
-        if (!dataLogger.existsFile()) 
-        {
-            Serial.println("(I) - write csv-header");
-            dataLogger.appendFile("date,time,latitude,longitude,temperature,humidity,pressure,ae,we,ppb\n");
-        }
-
         return true;
     }
     else 
@@ -204,8 +230,12 @@ void initDataLoggerRead()
     if (dataLogger.init()) 
     {
         u8x8.println("logger - ok");
-        dataLogger.readFile();
-        //dataLogger.deleteFile();
+        #if defined(OFFLINE_READ_FROM) && defined(OFFLINE_READ_TO)
+            dataLogger.readRange(OFFLINE_READ_FROM - payload_epoch, OFFLINE_READ_TO - payload_epoch);
+        #else
+            dataLogger.exportCsv();
+        #endif
+        //dataLogger.deleteLog();
     }
     else 
     {
@@ -230,8 +260,15 @@ void initLed()
 void initQueue()
 {
     Serial.println("(I) - init queue");
-    xQueue = xQueueCreate(1000, sizeof(EnvironmentData));
-    u8x8.println("queue - ok");
+    if (queue.begin(queuePartition, measurementWaitPeriod / 1000))
+    {
+        queue.printInfo();
+        u8x8.println("queue - ok");
+    }
+    else
+    {
+        u8x8.println("queue - err");
+    }
 }
 
 void initLmic()
@@ -247,11 +284,15 @@ void measureAndSend(osjob_t* j)
     no2.readGPS(&currentData);
     displayGPS(&currentData);
 
+    #ifdef OFFLINE_WRITE_MODE
+        removeLogged(dataLogger.flushIfDue());
+    #endif
+
     #ifdef TOGGLE_MODE
         if (toggleOn) {
             // only send data if toggle button is on
             send();
-            if (uxQueueMessagesWaiting(xQueue) == 0) 
+            if (queuedMessages() == 0) 
             {
                 // switch to measure mode if no more messages to send
                 setToggleButton(false);
@@ -289,11 +330,13 @@ void measure()
 
         u8x8.clearLine(7);
 
-        if (xQueueSend(xQueue, &currentData, xTicksToWait))
+        MeasurementRecord record;
+        record.pack(&currentData);
+        if (queue.enqueue(&record))
         {
             Serial.printf("(M) - added message to queue (waiting: %d, free: %d)\n", 
-                uxQueueMessagesWaiting(xQueue),
-                uxQueueSpacesAvailable(xQueue));
+                queuedMessages(),
+                queue.spaces());
             displayQueue();
         }
     }
@@ -313,8 +356,24 @@ void send()
 {
     // check if it is time for sending
     unsigned long elapsedTime = millis() - lastSending;
-    EnvironmentData data;
-    if(elapsedTime > sendingWaitPeriod && xQueuePeek(xQueue, &data, xTicksToWait))
+    bool ready = elapsedTime > sendingWaitPeriod;
+
+    #ifdef OFFLINE_WRITE_MODE
+        // records downsampled or dropped by the queue are logged again from the oldest
+        if (loggedGeneration != queue.generation())
+        {
+            loggedRecords = 0;
+            loggedGeneration = queue.generation();
+        }
+        MeasurementRecord record;
+        ready = ready && queue.peek(loggedRecords, &record);
+    #endif
+
+    #ifndef OFFLINE_WRITE_MODE
+        ready = ready && fillBatch() > 0;
+    #endif
+
+    if (ready)
     {
         lastSending = millis();
 
@@ -322,12 +381,10 @@ void send()
             Serial.println("(S) ================================");
             Serial.println("(S) - start data logging");
 
-            // append data to file
-            char message[200];
-            currentData.logger_message(message);
+            // append the oldest record of the queue which is not logged yet
             u8x8.clearLine(7);
             u8x8.setCursor(0, 7);
-            bool success = dataLogger.appendFile(message);
+            bool success = dataLogger.append(&record);
             if (success) 
             {
                 u8x8.printf("append - ok");
@@ -349,21 +406,21 @@ void send()
             u8x8.setCursor(0, 7);
             u8x8.printf("sending");
 
-            // get lora message formatted
-            char message[100];
-            data.lora_message(message);
-            Serial.printf("(S) - message: %s\n", message);
-
-            // convert char-array to int-array
-            uint8_t lmic_data[strlen(message)];
-            for(int idx = 0; idx < strlen(message); idx++)
+            // pack the queued records into the frame of the current datarate with the 
+            // least airtime per record (see uplink.h)
+            uint8_t lmic_data[payload_batch_size_max];
+            UplinkPlan plan = uplink_compose(batch, batchCount, lmic_data, measurementWaitPeriod);
+            batchSent = plan.records;
+            Serial.print("(S) - payload: ");
+            for (int idx = 0; idx < plan.length; idx++)
             {
-                lmic_data[idx] = (uint8_t)message[idx];
+                Serial.printf("%02x", lmic_data[idx]);
             }
-            Serial.printf("(S) - message size: %d\n", sizeof(lmic_data));
+            Serial.printf("\n(S) - payload size: %d (port: %d, records: %d, fields: %04x, datarate: %d, airtime: %d ms)\n", 
+                plan.length, plan.port, plan.records, plan.fields, LMIC.datarate, osticks2ms(plan.airtime));
             
             // sending data via lorawan
-            LMIC_setTxData2(1, lmic_data, sizeof(lmic_data), 1);
+            LMIC_setTxData2(plan.port, lmic_data, plan.length, 1);
         #endif
     }
     else 
@@ -453,18 +510,46 @@ void messageSent(bool removeFromQueue)
 {
     u8x8.clearLine(7);
 
-    // if sending was successful remove the message from the queue
-    if (removeFromQueue && uxQueueMessagesWaiting(xQueue) > 0) 
-    {
-        EnvironmentData data;
-        if (xQueueReceive(xQueue, &data, xTicksToWait)) 
+    // if logging was successful remove the messages which are in the file from the queue
+    #ifdef OFFLINE_WRITE_MODE
+        if (removeFromQueue)
+        {
+            loggedRecords++;
+        }
+        removeLogged(removeFromQueue);
+    #endif
+
+    // if sending was successful remove the sent records of the batch as a group
+    #ifndef OFFLINE_WRITE_MODE
+        if (removeFromQueue && batchSent > 0)
         {
-            Serial.printf("(S) - removed message from queue (waiting: %d, free: %d)\n", 
-                uxQueueMessagesWaiting(xQueue), 
-                uxQueueSpacesAvailable(xQueue));
+            int records = batchSent;
+            batchSent = 0;
+            if (batchGeneration != queue.generation())
+            {
+                // the sent records may have been merged or dropped, nothing is removed (a
+                // record is rather sent twice than lost)
+                Serial.println("(S) - queue changed while sending, reading the batch again");
+                batchCount = 0;
+                records = 0;
+            }
+            else if (queue.ack(records))
+            {
+                batchCount -= records;
+                memmove(batch, batch + records, batchCount * sizeof(EnvironmentData));
+            }
+            else
+            {
+                // the records stay in the queue, read them again
+                batchCount = 0;
+            }
+            Serial.printf("(S) - removed %d messages from queue (waiting: %d, free: %d)\n", 
+                records,
+                queuedMessages(), 
+                queue.spaces());
             displayQueue();
         }
-    }
+    #endif
 
     // trigger the next measurement
     os_setTimedCallback(&sendjob, os_getTime()+sec2osticks(1), measureAndSend);
@@ -502,7 +587,56 @@ void displayData(EnvironmentData *data)
 void displayQueue() 
 {
     u8x8.setCursor(0, 6);
-    u8x8.printf("queue %03d", uxQueueMessagesWaiting(xQueue));
+    u8x8.printf("queue %03d", queuedMessages());
+}
+
+/* Reads the oldest queued messages into the batch until it is full,
+ * returns the size of the batch
+ */
+int fillBatch()
+{
+    // records of the batch which were downsampled or dropped are not in the queue any more
+    if (batchGeneration != queue.generation())
+    {
+        batchCount = 0;
+    }
+
+    MeasurementRecord record;
+    while (batchCount < payload_batch_max && queue.peek(batchCount, &record))
+    {
+        record.unpack(&batch[batchCount++]);
+    }
+    batchGeneration = queue.generation();
+    return batchCount;
+}
+
+/* Removes the logged messages from the queue which are written to the file, after a 
+ * failed write the messages which are not acknowledged are logged again
+ */
+void removeLogged(bool success)
+{
+    if (!success || loggedGeneration != queue.generation())
+    {
+        loggedRecords = 0;
+        return;
+    }
+    int records = loggedRecords - dataLogger.pending();
+    if (records > 0 && queue.ack(records))
+    {
+        loggedRecords -= records;
+        Serial.printf("(S) - removed %d messages from queue (waiting: %d, free: %d)\n", 
+            records,
+            queue.count(), 
+            queue.spaces());
+        displayQueue();
+    }
+}
+
+/* Number of messages which are not sent yet (the batch is still in the queue)
+ */
+int queuedMessages()
+{
+    return queue.count();
 }
 
 static void readToggleButton() 
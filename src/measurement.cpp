@@ -6,31 +6,44 @@
  */
 
 #include "measurement.h"
+#include "statistics.h"
+#include "no2algorithm.h"
+#include "sensorarray.h"
+#include "calibration.h"
+#include "sht31.h"
+#include "i2cbus.h"
+#include "bmp180.h"
+#include "gps.h"
 
 #include <TimeLib.h>
-#include <Adafruit_SHT31.h>
-#include <Adafruit_Sensor.h>
-#include <Adafruit_BMP085_U.h>
-#include <Adafruit_ADS1015.h>
 
-#include <TinyGPS++.h> 
 #include <Wire.h>
 
 // Offset hours from gps time (UTC)
 const int UTC_offset = 1;   // Central European Time
 time_t prevDisplay = 0; // when the digital clock was displayed
 
-// Temperatur and Humidity sensor
-Adafruit_SHT31 sht31 = Adafruit_SHT31();
+// Temperatur and Humidity sensor (periodic acquisition mode)
+SHT31Sensor sht31;
 
-// Pressure sensor
-Adafruit_BMP085_Unified bmp = Adafruit_BMP085_Unified(10085);
+// Pressure sensor (background conversions)
+BMP180Sensor bmp;
 
-// analog digital converter
-Adafruit_ADS1115 ads = Adafruit_ADS1115();
+// alphasense sensor boards, each with its own ADS1115 analog digital converter
+SensorArray sensorArray;
 
-// NO2 sensor constants
-NO2Sensor sensors = NO2Sensor(202310057, 231, 225, 238, 234, 0.258);
+// calibration against the official station (coefficients are loaded from the flash memory)
+const char * calibrationPath = "/calibration.csv";
+CalibrationModel calibration;
+
+// ADS1115 acquisition task (runs on core 0, the arduino loop and LMIC run on core 1)
+const int acquisitionCore = 0;
+const int acquisitionPriority = 1;
+const int acquisitionStackSize = 4096;
+const int readingsCount = 30;
+const int readingsDelay = 1000;
+const float ads_multiplier = 0.03125F;
+const float readingsTrim = 0.1F; // fraction of readings dropped on each end for the trimmed mean
 
 NO2Sensor::NO2Sensor(uint32_t _serial_no, uint8_t _we_zero_electronic, uint8_t _we_zero_total, uint8_t _ae_zero_electronic, uint8_t _ae_zero_total, float _sensitivity)
 {
@@ -42,72 +55,19 @@ NO2Sensor::NO2Sensor(uint32_t _serial_no, uint8_t _we_zero_electronic, uint8_t _
     sensitivity = _sensitivity;
 }
 
-// GPS
-TinyGPSPlus gps;                            
-HardwareSerial Serial1(1);
-
-void EnvironmentData::lora_message(char* outStr) 
-{
-   /* example message:
-        * +22
-        * 32
-        * 0955
-        * 171209
-        * 103612
-        * 481597
-        * 115319
-        * 2401
-        * 2406
-        */
-
-    uint16_t year = gps_year;
-    if (year > 2000) 
-    {
-        year = year - 2000;
-    }
-
-    sprintf(outStr, "%+03.0f%02.0f%04.0f%02d%02d%02d%02d%02d%02d%06.0f%06.0f%06.0f%06.0f",
-        sht31_temperature,
-        sht31_humidity,
-        bmp180_pressure,
-        year,
-        gps_month,
-        gps_day,
-        gps_hour,
-        gps_minute,
-        gps_second,
-        gps_latitude * 10000,
-        gps_longitude * 10000,
-        no2_ae * 1000,
-        no2_we * 1000
-    );
-}
-
-void EnvironmentData::logger_message(char* outStr) 
-{
-    sprintf(outStr, "%4d-%02d-%02d,%02d:%02d:%02d,%f,%f,%f,%f,%f,%f,%f,%f\n",
-        gps_year,
-        gps_month,
-        gps_day,
-        gps_hour,
-        gps_minute,
-        gps_second,
-        gps_latitude,
-        gps_longitude,
-        sht31_temperature,
-        sht31_humidity,
-        bmp180_pressure,
-        no2_ae,
-        no2_we,
-        no2_ppb
-    );
-}
+// GPS (NMEA sentences are parsed in the background)
+GPSReceiver gps;
+const double gps_knots_to_mph = 1.150779;
 
 void NO2Measurement::init() 
 {
     // hardware serial for  GPS
     Serial.println("(I) - init GPS");
-    Serial1.begin(9600, SERIAL_8N1, 17, 16);
+    gps.begin(1, 9600, 17, 16);
+
+    // all I2C transactions go through the bus task
+    Serial.println("(I) - init I2C bus");
+    i2cBus.begin(SDA, SCL);
 
     // init SHT31
     Serial.println("(I) - init SHT31");
@@ -115,37 +75,128 @@ void NO2Measurement::init()
     sht31.heater(true);
     delay(2000);
     sht31.heater(false);
+    sht31.startPeriodic();
 
     // init BMP180
     Serial.println("(I) - init BMP180");
-    bmp.begin();
+    bmp.begin(0x77);
+
+    // init sensor array - NO2 sensor constants are shipped with the sensor
+    // (only NO2 boards are supported, no2algorithm.h has no O3/CO compensation tables)
+    Serial.println("(I) - init ADS1115 sensor array");
+    sensorArray.add(GasSensor(GAS_NO2, 0x48, NO2Sensor(202310057, 231, 225, 238, 234, 0.258), 
+        &NO2Algorithm<NO2_ALGORITHM>::ppb));
+
+    // load the calibration of the NO2 sensor
+    Serial.println("(I) - init calibration");
+    calibration.load(calibrationPath, sensorArray.sensor(0).calibration.serial_no);
+
+    // start the ADS1115 acquisition task which hands over completed windows
+    // through a single slot queue (always overwritten with the latest window)
+    Serial.println("(I) - init acquisition task");
+    windowQueue = xQueueCreate(1, sizeof(NO2Window));
+    xTaskCreatePinnedToCore(acquisitionTask, "acquisition", acquisitionStackSize, this, 
+        acquisitionPriority, NULL, acquisitionCore);
+}
+
+void NO2Measurement::acquisitionTask(void *parameter)
+{
+    NO2Measurement *measurement = (NO2Measurement *) parameter;
+    for (;;)
+    {
+        measurement->acquire();
+    }
+}
+
+void NO2Measurement::acquire()
+{
+    int sensorCount = sensorArray.count();
+    RunningStatistics stats_we[SENSOR_COUNT_MAX];
+    RunningStatistics stats_ae[SENSOR_COUNT_MAX];
+    int16_t op1[SENSOR_COUNT_MAX];
+    int16_t op2[SENSOR_COUNT_MAX];
+    bool started1[SENSOR_COUNT_MAX];
+    bool started2[SENSOR_COUNT_MAX];
+    bool valid1[SENSOR_COUNT_MAX];
+    bool valid2[SENSOR_COUNT_MAX];
+    TickType_t lastWakeTime = xTaskGetTickCount();
+
+    for (int j = 0; j < readingsCount; j++)
+    {
+        // start the conversion on all ADS1115 at once and collect them afterwards
+        // (vTaskDelay may return up to one tick early, so one tick is added)
+        sensorArray.startWE(started1);
+        vTaskDelay(pdMS_TO_TICKS(SensorArray::conversionDelay) + 1);
+        sensorArray.collect(op1, valid1);    // ADC ports 0 and 1
+
+        sensorArray.startAE(started2);
+        vTaskDelay(pdMS_TO_TICKS(SensorArray::conversionDelay) + 1);
+        sensorArray.collect(op2, valid2);    // ADC ports 2 and 3
+
+        // failed transactions are left out of the window (without a started conversion
+        // the conversion register still holds the value of the other port)
+        for (int i = 0; i < sensorCount; i++)
+        {
+            if (started1[i] && valid1[i] && started2[i] && valid2[i])
+            {
+                stats_we[i].add(op1[i] * ads_multiplier);
+                stats_ae[i].add(op2[i] * ads_multiplier);
+            }
+        }
+
+        vTaskDelayUntil(&lastWakeTime, pdMS_TO_TICKS(readingsDelay));
+    }
 
-    // init ADS1115
-    Serial.println("(I) - init ADS1115");
-    ads.setGain(GAIN_FOUR);
-    ads.begin();
+    // robust averaged values for WE and Aux plus their noise figures
+    NO2Window window;
+    window.sensors = sensorCount;
+    for (int i = 0; i < sensorCount; i++)
+    {
+        window.samples[i] = stats_we[i].count();
+        if (window.samples[i] == 0)
+        {
+            // no reading of the window succeeded, the sensor is missing (not 0 mV)
+            window.we[i] = window.ae[i] = NAN;
+            window.we_stddev[i] = window.ae_stddev[i] = NAN;
+            window.we_spread[i] = window.ae_spread[i] = NAN;
+            continue;
+        }
+        window.we[i] = stats_we[i].trimmedMean(readingsTrim);
+        window.ae[i] = stats_ae[i].trimmedMean(readingsTrim);
+        window.we_stddev[i] = stats_we[i].stddev();
+        window.ae_stddev[i] = stats_ae[i].stddev();
+        window.we_spread[i] = stats_we[i].spread();
+        window.ae_spread[i] = stats_ae[i].spread();
+    }
+    window.timestamp = millis();
+    xQueueOverwrite(windowQueue, &window);
 }
 
 void NO2Measurement::measure(EnvironmentData *data)
 {
     readSHT31(data);
     readBMP085(data);
+
     readNO2(data);
+
+    if (loggingEnabled)
+    {
+        i2cBus.printInfo();
+    }
 }
 
 void NO2Measurement::readSHT31(EnvironmentData *data) 
 {
-    uint16_t status = sht31.readStatus();
-
-    float t = sht31.readTemperature();
-    if (isnan(t)) 
+    // temperature and humidity are fetched together in one CRC checked read
+    float t, h;
+    if (!sht31.read(&t, &h)) 
     {
-        Serial.println("***** I2C error ******");
-        Wire.reset();
-        //sht31.reset();
-        t = sht31.readTemperature();
+        // restart the periodic acquisition (e.g. after a brown-out of the sensor), 
+        // the next measurement will have valid values again
+        Serial.printf("***** SHT31 read error (crc errors: %d) ******\n", sht31.crcErrors());
+        sht31.stopPeriodic();
+        sht31.startPeriodic();
     }
-    float h = sht31.readHumidity();
 
     data->sht31_temperature = t;
     data->sht31_humidity = h;
@@ -158,177 +209,163 @@ void NO2Measurement::readSHT31(EnvironmentData *data)
 
 void NO2Measurement::readBMP085(EnvironmentData *data) 
 {
-    sensors_event_t event;
-    bmp.getEvent(&event);
-    if (event.pressure)
+    // take the latest reading of the BMP180 task (does not block)
+    BMP180Reading reading;
+    if (bmp.latest(&reading))
     {
-        float p = event.pressure;
-        float t;
-        bmp.getTemperature(&t);
-        float seaLevelPressure = SENSORS_PRESSURE_SEALEVELHPA;
-        float a = bmp.pressureToAltitude(seaLevelPressure, p, t);
-
-        data->bmp180_temperature = t;
-        data->bmp180_pressure = p;
-        data->bmp180_altitude = a;
+        data->bmp180_temperature = reading.temperature;
+        data->bmp180_pressure = reading.pressure;
+        data->bmp180_altitude = reading.altitude;
 
         if (loggingEnabled) 
         {
-            Serial.printf("(M) - BMP180 - temperature: %f, pressure: %f, altitude: %f\n", t, p, a);
+            Serial.printf("(M) - BMP180 - temperature: %f, pressure: %f, altitude: %f\n", 
+                reading.temperature, reading.pressure, reading.altitude);
         }
     }
 }
 
 void NO2Measurement::readNO2(EnvironmentData *data) 
 {
-    // read NO2
-    int readingsCount = 30;
-    int readingsDelay = 1000;
-    float ads_multiplier = 0.03125F;
-    uint32_t acc_op1 = 0; // accumulator 1 value
-    uint32_t acc_op2 = 0; // accumulator 2 value
-
-    for (int j = 0; j < readingsCount; j++)
+    data->no2_we = NAN;
+    data->no2_ae = NAN;
+    data->no2_ppb = NAN;
+    data->no2_we_stddev = NAN;
+    data->no2_ae_stddev = NAN;
+    data->no2_ugm3 = NAN;
+    data->calibration_version = 0;
+    data->o3_ppb = NAN;
+    data->co_ppb = NAN;
+
+    // take the latest averaging window of the acquisition task (does not block)
+    NO2Window window;
+    if (!xQueuePeek(windowQueue, &window, 0))
     {
-        int16_t op1 = ads.readADC_Differential_0_1();    // Read ADC ports 0 and 1    
-        int16_t op2 = ads.readADC_Differential_2_3();    // Read ADC ports 2 and 3
-
-        acc_op1 += op1;
-        acc_op2 += op2;
-
-        delay(readingsDelay);
+        if (loggingEnabled) 
+        {
+            Serial.println("(M) - SKIP NO2 - no averaging window available yet");
+        }
+        return;
     }
 
-    // averaged values for WE and Aux
-    float op1 = (acc_op1 / readingsCount);
-    float op2 = (acc_op2 / readingsCount);
-    float we = op1 * ads_multiplier;
-    float ae = op2 * ads_multiplier;
-
-    // skip values greater than 999 because they do not fit into the lora-message
-    if (we < 0 || we > 999 || ae < 0 || ae > 999) 
+    bool no2Found = false;
+    for (int i = 0; i < window.sensors; i++)
     {
-        data->no2_we = 0;
-        data->no2_ae = 0;
-        data->no2_ppb = 0;
+        GasSensor &sensor = sensorArray.sensor(i);
+        float we = window.we[i];
+        float ae = window.ae[i];
 
-        if (loggingEnabled) 
+        // skip a sensor without valid readings and values greater than 999 because they 
+        // do not fit into the lora-message
+        if (window.samples[i] == 0 || we < 0 || we > 999 || ae < 0 || ae > 999) 
         {
-            Serial.printf("(M) - SKIP NO2 - we: %f, ae: %f\n", ae, we);
+            if (loggingEnabled) 
+            {
+                Serial.printf("(M) - SKIP sensor %d - we: %f, ae: %f\n", i, we, ae);
+            }
+            continue;
         }
-    }
-    else 
-    {
-        // simple ppb calculation (see alphasense datasheet)
-        float ppb = no2_algorithm_simple(sensors, we, ae);
-        data->no2_we = we;
-        data->no2_ae = ae;
-        data->no2_ppb = ppb;
+
+        // ppb calculation with the gas specific algorithm of the sensor (see no2algorithm.h)
+        float ppb = sensor.algorithm(sensor.calibration, we, ae, data->sht31_temperature);
 
         if (loggingEnabled) 
         {
-            Serial.printf("(M) - NO2 - we: %f, ae: %f, ppb: %f\n", ae, we, ppb);
+            Serial.printf("(M) - sensor %d - we: %f, ae: %f, ppb: %f, readings: %d\n", i, we, ae, ppb, window.samples[i]);
+            Serial.printf("(M) - sensor %d - we-stddev: %f, ae-stddev: %f, we-spread: %f, ae-spread: %f\n", 
+                i, window.we_stddev[i], window.ae_stddev[i], window.we_spread[i], window.ae_spread[i]);
         }
-    }
-}
 
-float NO2Measurement::no2_algorithm_simple(NO2Sensor sensor, float we, float ae) 
-{
-    if (loggingEnabled) 
-    {
-        /*
-        Serial.printf("(M) - NO2 calculation - we-zero: %d, ae-zero: %d, sensitivity: %f\n", 
-            sensor.we_zero_total,
-            sensor.ae_zero_total,
-            sensor.sensitivity);
-        */
-    }
+        // the first NO2 sensor provides the NO2 values of the measurement
+        if (sensor.gas == GAS_NO2 && !no2Found)
+        {
+            no2Found = true;
+            data->no2_we = we;
+            data->no2_ae = ae;
+            data->no2_ppb = ppb;
+            data->no2_we_stddev = window.we_stddev[i];
+            data->no2_ae_stddev = window.ae_stddev[i];
+        }
 
-    float c = we - sensor.we_zero_total;
-    if (c < 0) 
-    {
-        c = 0;
+        // the first O3 and CO sensor provide the O3 and CO values
+        if (sensor.gas == GAS_O3 && isnan(data->o3_ppb))
+        {
+            data->o3_ppb = ppb;
+        }
+        if (sensor.gas == GAS_CO && isnan(data->co_ppb))
+        {
+            data->co_ppb = ppb;
+        }
     }
 
-    float e = ae - sensor.ae_zero_total;
-    if (e < 0)
+    // calibrated NO2 concentration in ug/m3 (needs temperature, humidity and pressure)
+    if (no2Found && calibration.isLoaded())
     {
-        e = 0;
-    }
+        data->no2_ugm3 = calibration.evaluate(data);
+        data->calibration_version = calibration.version();
 
-    float f = c / sensor.sensitivity;
-    float g = c - e;
-    if (g < 0)
-    {
-        g = 0;
+        if (loggingEnabled) 
+        {
+            Serial.printf("(M) - NO2 - calibration: %d, ug/m3: %f\n", data->calibration_version, data->no2_ugm3);
+        }
     }
+}
 
-    float h = g / sensor.sensitivity;
+// serial number of the NO2 sensor (written into the header of the offline log)
+uint32_t NO2Measurement::serialNo()
+{
+    return sensorArray.sensor(0).calibration.serial_no;
+}
 
-    return h;
+/*
+ * Hands the older fixes back to the GPS task (called from the loop, so its ring does
+ * not run full while no measurement is taken and the next fix is the current one)
+ */
+void NO2Measurement::releaseGPSFixes()
+{
+    gps.latest();
 }
 
 void NO2Measurement::readGPS(EnvironmentData *data) 
 {
-    while (Serial1.available() > 0) 
+    // take the latest fix of the GPS task (does not block, read in place)
+    const GPSFix *latest = gps.latest();
+    GPSFix none;
+    const GPSFix &fix = latest != NULL ? *latest : none;
+    if (latest != NULL)
     {
-        if (gps.encode(Serial1.read())) 
+        if (fix.dateTimeValid)
         {
-            if (gps.date.isValid() && gps.time.isValid())
+            // Set Time from GPS data string
+            setTime(fix.hour, fix.minute, fix.second, fix.day, fix.month, fix.year);
+            // Calc current Time Zone time by offset value
+            adjustTime(UTC_offset * SECS_PER_HOUR); 
+
+            if (timeStatus()!= timeNotSet) 
             {
-                int Year = gps.date.year();
-                byte Month = gps.date.month();
-                byte Day = gps.date.day();
-                byte Hour = gps.time.hour();
-                byte Minute = gps.time.minute();
-                byte Second = gps.time.second();
-
-                // Set Time from GPS data string
-                setTime(Hour, Minute, Second, Day, Month, Year);
-                // Calc current Time Zone time by offset value
-                adjustTime(UTC_offset * SECS_PER_HOUR); 
-
-                if (timeStatus()!= timeNotSet) 
+                if (now() != prevDisplay) 
                 {
-                    if (now() != prevDisplay) 
-                    {
-                        prevDisplay = now();
-                        data->gps_year = year();
-                        data->gps_month = month();
-                        data->gps_day = day();
-                        data->gps_hour = hour();
-                        data->gps_minute = minute();
-                        data->gps_second = second();
-                    }
+                    prevDisplay = now();
+                    data->gps_year = year();
+                    data->gps_month = month();
+                    data->gps_day = day();
+                    data->gps_hour = hour();
+                    data->gps_minute = minute();
+                    data->gps_second = second();
                 }
             }
+        }
 
-            if (gps.location.isValid()) 
-            {
-                data->gps_latitude = gps.location.lat();
-                data->gps_longitude = gps.location.lng();
-            }
-
-            if (gps.altitude.isValid()) 
-            {
-                data->gps_altitude = gps.altitude.meters();
-            }
-
-            if (gps.satellites.isValid())
-            {
-                data->gps_satellites = gps.satellites.value();
-            }
-
-            if(gps.course.isValid()) 
-            {
-                data->gps_course = gps.course.deg();
-            }
-
-            if(gps.speed.isValid()) 
-            {
-                data->gps_speed = gps.speed.mph();
-            }
+        if (fix.locationValid) 
+        {
+            data->gps_latitude = fix.latitude / 1000000.0;
+            data->gps_longitude = fix.longitude / 1000000.0;
         }
+
+        data->gps_altitude = fix.altitude / 100.0;
+        data->gps_satellites = fix.satellites;
+        data->gps_course = fix.course / 100.0;
+        data->gps_speed = fix.speed * gps_knots_to_mph / 100.0;
     }
 
     if (loggingEnabled) 
@@ -338,5 +375,7 @@ void NO2Measurement::readGPS(EnvironmentData *data)
             data->gps_hour, data->gps_minute, data->gps_second);
         Serial.printf("(M) - GPS - location: %f/%f\n", 
             data->gps_latitude, data->gps_longitude);
+        Serial.printf("(M) - GPS - fix age: %lu ms, overflows: %d, checksum errors: %d, dropped fixes: %d\n", 
+            millis() - fix.timestamp, gps.overflows(), gps.checksumErrors(), gps.droppedFixes());
     }
 }
\ No newline at end of file
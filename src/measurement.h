@@ -15,6 +15,9 @@
 extern "C"{
 #endif
 
+// maximum number of alphasense sensor boards (one ADS1115 each on 0x48 - 0x4B)
+#define SENSOR_COUNT_MAX 4
+
 /* 
  * This class holds all measurement data of one measurement iteration
  */
@@ -38,12 +41,27 @@ public:
     uint32_t  gps_satellites = 0;
     double    gps_course = 0;
     double    gps_speed = 0;
-    float     no2_ae;
-    float     no2_we;
-    float     no2_ppb;
+    float     no2_ae = NAN;
+    float     no2_we = NAN;
+    float     no2_ppb = NAN;
+    float     no2_we_stddev = NAN;
+    float     no2_ae_stddev = NAN;
+    float     no2_we_min = NAN;  // range of the merged measurements (see MeasurementRecord::merge)
+    float     no2_we_max = NAN;
+    float     no2_ugm3 = NAN;
+    uint16_t  calibration_version = 0;
+    uint16_t  samples = 1;      // measurements merged into the values (see MeasurementRecord::merge)
+    float     o3_ppb = NAN;
+    float     co_ppb = NAN;
 
-    void lora_message(char* outStr);
-    void logger_message(char* outStr);
+    int lora_message(char* outStr, int size);
+    int logger_message(char* outStr, int size);
+    int lora_payload(uint8_t *buffer);
+    bool from_lora_payload(const uint8_t *buffer, int length);
+    void payload_values(double *values);
+    void from_payload_values(const double *values);
+    void payload_fields(int32_t *values);
+    void from_payload_fields(const int32_t *values);
 };
 
 /* 
@@ -61,6 +79,24 @@ public:
     NO2Sensor(uint32_t _serial_no, uint8_t _we_zero_electronic, uint8_t _we_zero_total, uint8_t _ae_zero_electronic, uint8_t _ae_zero_total, float _sensitivity);
 };
 
+/* 
+ * This class holds one completed averaging window of the ADS1115 acquisition task
+ * (one entry per sensor of the sensor array)
+ */
+class NO2Window
+{
+public:
+    uint8_t sensors = 0;
+    float we[SENSOR_COUNT_MAX];
+    float ae[SENSOR_COUNT_MAX];
+    float we_stddev[SENSOR_COUNT_MAX];
+    float ae_stddev[SENSOR_COUNT_MAX];
+    float we_spread[SENSOR_COUNT_MAX];
+    float ae_spread[SENSOR_COUNT_MAX];
+    uint16_t samples[SENSOR_COUNT_MAX];     // valid readings of the window (0 = sensor not readable)
+    unsigned long timestamp = 0;
+};
+
 /* 
  * This class is responsible for the measurement of temperature, humidity, pressure, NO2 and GPS
  */
@@ -70,12 +106,16 @@ public:
     void init();
     void measure(EnvironmentData *data);
     void readGPS(EnvironmentData *data);
+    void releaseGPSFixes();
+    uint32_t serialNo();
 private:
     bool loggingEnabled = true;
+    QueueHandle_t windowQueue;
+    static void acquisitionTask(void *parameter);
+    void acquire();
     void readSHT31(EnvironmentData *data);
     void readBMP085(EnvironmentData *data);
     void readNO2(EnvironmentData *data);
-    float no2_algorithm_simple(NO2Sensor sensor, float we, float ae);
 };
 
 #ifdef __cplusplus
@@ -0,0 +1,83 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Text messages of the measurement (ascii lora-message and CSV line of the data logger)
+ */
+
+#include "measurement.h"
+#include "textwriter.h"
+
+int EnvironmentData::lora_message(char* outStr, int size) 
+{
+   /* example message:
+        * +22
+        * 32
+        * 0955
+        * 171209
+        * 103612
+        * 481597
+        * 115319
+        * 2401
+        * 2406
+        */
+
+    uint16_t year = gps_year;
+    if (year > 2000) 
+    {
+        year = year - 2000;
+    }
+
+    TextWriter text(outStr, size);
+    text.writeFixed(sht31_temperature, 0, 3, true);
+    text.writeFixed(sht31_humidity, 0, 2);
+    text.writeFixed(bmp180_pressure, 0, 4);
+    text.writeInt(year, 2);
+    text.writeInt(gps_month, 2);
+    text.writeInt(gps_day, 2);
+    text.writeInt(gps_hour, 2);
+    text.writeInt(gps_minute, 2);
+    text.writeInt(gps_second, 2);
+    text.writeFixed(gps_latitude * 10000, 0, 6);
+    text.writeFixed(gps_longitude * 10000, 0, 6);
+    text.writeFixed(no2_ae * 1000, 0, 6);
+    text.writeFixed(no2_we * 1000, 0, 6);
+    return text.length();
+}
+
+int EnvironmentData::logger_message(char* outStr, int size) 
+{
+    // same text as "%4d-%02d-%02d,%02d:%02d:%02d,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%d,%d,%f,%f\n"
+    TextWriter text(outStr, size);
+    text.writeInt(gps_year, 4, ' ');
+    text.write('-');
+    text.writeInt(gps_month, 2);
+    text.write('-');
+    text.writeInt(gps_day, 2);
+    text.write(',');
+    text.writeInt(gps_hour, 2);
+    text.write(':');
+    text.writeInt(gps_minute, 2);
+    text.write(':');
+    text.writeInt(gps_second, 2);
+
+    const double values[] = { gps_latitude, gps_longitude, sht31_temperature, sht31_humidity, bmp180_pressure, no2_ae, no2_we, no2_ppb, 
+        no2_we_stddev, no2_ae_stddev, o3_ppb, co_ppb, no2_ugm3 };
+    for (double value : values)
+    {
+        text.write(',');
+        text.writeFixed(value, 6);
+    }
+    text.write(',');
+    text.writeInt(calibration_version);
+    text.write(',');
+    text.writeInt(samples);
+    text.write(',');
+    text.writeFixed(no2_we_min, 6);
+    text.write(',');
+    text.writeFixed(no2_we_max, 6);
+    text.write('\n');
+    return text.length();
+}
@@ -0,0 +1,287 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "nmea.h"
+
+// last three characters of the sentence type (talker GP, GN, GL, ... is ignored)
+const uint32_t nmea_type_rmc = ('R' << 16) | ('M' << 8) | 'C';
+const uint32_t nmea_type_gga = ('G' << 16) | ('G' << 8) | 'A';
+
+const int32_t nmea_pow10[] = { 1, 10, 100, 1000, 10000, 100000, 1000000 };
+
+bool NMEAParser::encode(char c, GPSFix *fix)
+{
+    if (c == '$')
+    {
+        startSentence();
+        return false;
+    }
+
+    switch (part)
+    {
+        case NMEA_FIELDS:
+            if (c == '*')
+            {
+                endField();
+                part = NMEA_CHECKSUM;
+            }
+            else if (c == '\r' || c == '\n')
+            {
+                // sentence without checksum
+                part = NMEA_IDLE;
+            }
+            else
+            {
+                checksum ^= c;
+                if (c == ',')
+                {
+                    endField();
+                    field++;
+                    startField();
+                }
+                else if (field == 0)
+                {
+                    type = ((type << 8) | c) & 0xFFFFFF;
+                }
+                else if (c >= '0' && c <= '9')
+                {
+                    empty = false;
+                    if (!dot)
+                    {
+                        integer = integer * 10 + (c - '0');
+                    }
+                    else if (fractionDigits < maxFraction)
+                    {
+                        fraction = fraction * 10 + (c - '0');
+                        fractionDigits++;
+                    }
+                }
+                else if (c == '.')
+                {
+                    dot = true;
+                }
+                else if (c == '-')
+                {
+                    negative = true;
+                }
+                else if (letter == 0)
+                {
+                    empty = false;
+                    letter = c;
+                }
+            }
+            return false;
+
+        case NMEA_CHECKSUM:
+        {
+            int8_t value = hexValue(c);
+            if (value < 0)
+            {
+                part = NMEA_IDLE;
+                return false;
+            }
+            receivedChecksum = (receivedChecksum << 4) | value;
+            if (++checksumDigits < 2)
+            {
+                return false;
+            }
+
+            part = NMEA_IDLE;
+            if (receivedChecksum != checksum)
+            {
+                checksumErrorCount++;
+                return false;
+            }
+            sentenceCount++;
+            if (sentence == NMEA_OTHER)
+            {
+                return false;
+            }
+            apply(fix);
+            return true;
+        }
+
+        default:
+            return false;
+    }
+}
+
+uint32_t NMEAParser::sentences()
+{
+    return sentenceCount;
+}
+
+uint32_t NMEAParser::checksumErrors()
+{
+    return checksumErrorCount;
+}
+
+void NMEAParser::startSentence()
+{
+    part = NMEA_FIELDS;
+    sentence = NMEA_OTHER;
+    checksum = 0;
+    receivedChecksum = 0;
+    checksumDigits = 0;
+    field = 0;
+    type = 0;
+    active = false;
+    hasTime = false;
+    hasDate = false;
+    hasLatitude = false;
+    hasLongitude = false;
+    hasAltitude = false;
+    hasSatellites = false;
+    hasCourse = false;
+    hasSpeed = false;
+    startField();
+}
+
+void NMEAParser::startField()
+{
+    integer = 0;
+    fraction = 0;
+    fractionDigits = 0;
+    dot = false;
+    negative = false;
+    empty = true;
+    letter = 0;
+}
+
+void NMEAParser::endField()
+{
+    if (field == 0)
+    {
+        sentence = type == nmea_type_rmc ? NMEA_RMC : type == nmea_type_gga ? NMEA_GGA : NMEA_OTHER;
+        return;
+    }
+
+    if (sentence == NMEA_RMC)
+    {
+        // $GPRMC,time,status,lat,N/S,lon,E/W,speed (knots),course,date,...
+        switch (field)
+        {
+            case 1: time = integer; hasTime = !empty; break;
+            case 2: active = letter == 'A'; break;
+            case 3: latitude = coordinate(); hasLatitude = !empty; break;
+            case 4: if (letter == 'S') latitude = -latitude; break;
+            case 5: longitude = coordinate(); hasLongitude = !empty; break;
+            case 6: if (letter == 'W') longitude = -longitude; break;
+            case 7: speed = scaled(2); hasSpeed = !empty; break;
+            case 8: course = scaled(2); hasCourse = !empty; break;
+            case 9: date = integer; hasDate = !empty; break;
+        }
+    }
+    else if (sentence == NMEA_GGA)
+    {
+        // $GPGGA,time,lat,N/S,lon,E/W,quality,satellites,hdop,altitude,M,...
+        switch (field)
+        {
+            case 1: time = integer; hasTime = !empty; break;
+            case 2: latitude = coordinate(); hasLatitude = !empty; break;
+            case 3: if (letter == 'S') latitude = -latitude; break;
+            case 4: longitude = coordinate(); hasLongitude = !empty; break;
+            case 5: if (letter == 'W') longitude = -longitude; break;
+            case 6: active = !empty && integer > 0; break;
+            case 7: satellites = integer; hasSatellites = !empty; break;
+            case 9: altitude = scaled(2); hasAltitude = !empty; break;
+        }
+    }
+}
+
+void NMEAParser::apply(GPSFix *fix)
+{
+    // only RMC has the date, the time of GGA alone could be of the next day
+    if (hasTime && hasDate)
+    {
+        fix->dateTimeValid = true;
+        fix->hour = time / 10000;
+        fix->minute = time / 100 % 100;
+        fix->second = time % 100;
+        fix->day = date / 10000;
+        fix->month = date / 100 % 100;
+        fix->year = 2000 + date % 100;
+    }
+
+    if (hasSatellites)
+    {
+        fix->satellites = satellites;
+    }
+
+    if (!active)
+    {
+        return;
+    }
+
+    if (hasLatitude && hasLongitude)
+    {
+        fix->locationValid = true;
+        fix->latitude = latitude;
+        fix->longitude = longitude;
+    }
+    if (hasAltitude)
+    {
+        fix->altitude = altitude;
+    }
+    if (hasCourse)
+    {
+        fix->course = course;
+    }
+    if (hasSpeed)
+    {
+        fix->speed = speed;
+    }
+}
+
+/* 
+ * Value of the current field with a fixed number of decimal digits (e.g. 2 - 1/100)
+ */
+int32_t NMEAParser::scaled(int digits)
+{
+    int32_t value = integer * nmea_pow10[digits];
+    if (fractionDigits > digits)
+    {
+        value += fraction / nmea_pow10[fractionDigits - digits];
+    }
+    else
+    {
+        value += fraction * nmea_pow10[digits - fractionDigits];
+    }
+    return negative ? -value : value;
+}
+
+/* 
+ * Coordinate of the current field (ddmm.mmmmm or dddmm.mmmmm) in micro degrees
+ */
+int32_t NMEAParser::coordinate()
+{
+    int32_t degrees = integer / 100;
+    int32_t minutes = integer % 100;
+    int32_t fractionDigits5 = fractionDigits > 5 ? 5 : fractionDigits;
+    int32_t minutesE5 = minutes * 100000 
+        + fraction / nmea_pow10[fractionDigits - fractionDigits5] * nmea_pow10[5 - fractionDigits5];
+
+    // minutes / 60 * 10^6 = minutes * 10^5 / 6
+    return degrees * 1000000 + (minutesE5 + 3) / 6;
+}
+
+int8_t NMEAParser::hexValue(char c)
+{
+    if (c >= '0' && c <= '9')
+    {
+        return c - '0';
+    }
+    if (c >= 'A' && c <= 'F')
+    {
+        return c - 'A' + 10;
+    }
+    if (c >= 'a' && c <= 'f')
+    {
+        return c - 'a' + 10;
+    }
+    return -1;
+}
@@ -0,0 +1,87 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _nmea_h_
+#define _nmea_h_
+
+#include "gps.h"
+
+/* 
+ * Incremental NMEA parser for the two sentences the measurement needs: RMC (date, time, 
+ * position, speed, course) and GGA (position, satellites, altitude). Each character is 
+ * consumed directly, the numeric fields are accumulated as integers while they arrive 
+ * (no field buffer, no heap, no floating point) and the checksum is calculated on the fly. 
+ * The values of a sentence are only applied to the fix when its checksum is correct.
+ */
+class NMEAParser
+{
+public:
+    bool encode(char c, GPSFix *fix);
+    uint32_t sentences();
+    uint32_t checksumErrors();
+private:
+    static const int maxFraction = 6;
+    enum Sentence
+    {
+        NMEA_OTHER,
+        NMEA_RMC,
+        NMEA_GGA
+    };
+    enum Part
+    {
+        NMEA_IDLE,
+        NMEA_FIELDS,
+        NMEA_CHECKSUM
+    };
+    Part part = NMEA_IDLE;
+    Sentence sentence = NMEA_OTHER;
+    uint8_t checksum = 0;
+    uint8_t receivedChecksum = 0;
+    uint8_t checksumDigits = 0;
+    uint8_t field = 0;
+    uint32_t sentenceCount = 0;
+    uint32_t checksumErrorCount = 0;
+
+    // the field which is currently received
+    uint32_t type = 0;
+    int32_t integer = 0;
+    int32_t fraction = 0;
+    uint8_t fractionDigits = 0;
+    bool dot = false;
+    bool negative = false;
+    bool empty = true;
+    char letter = 0;
+
+    // the values of the current sentence (applied when the checksum is correct)
+    bool active = false;
+    bool hasTime = false;
+    bool hasDate = false;
+    bool hasLatitude = false;
+    bool hasLongitude = false;
+    bool hasAltitude = false;
+    bool hasSatellites = false;
+    bool hasCourse = false;
+    bool hasSpeed = false;
+    uint32_t time = 0;
+    uint32_t date = 0;
+    int32_t latitude = 0;
+    int32_t longitude = 0;
+    int32_t altitude = 0;
+    uint8_t satellites = 0;
+    uint16_t course = 0;
+    uint32_t speed = 0;
+
+    void startSentence();
+    void startField();
+    void endField();
+    void apply(GPSFix *fix);
+    int32_t scaled(int digits);
+    int32_t coordinate();
+    static int8_t hexValue(char c);
+};
+
+#endif
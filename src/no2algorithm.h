@@ -0,0 +1,144 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Conversion of the averaged WE/AE voltages (mV) into NO2 ppb.
+ * 
+ * Besides the simple datasheet formula the four temperature compensation
+ * algorithms of the Alphasense application note AAN 803 are available. 
+ * The algorithm is selected at compile time with NO2_ALGORITHM. The correction
+ * factors are those of the NO2-A43F, O3 and CO boards are not supported.
+ */
+
+#ifndef _no2algorithm_h_
+#define _no2algorithm_h_
+
+#include "measurement.h"
+
+#define NO2_ALGORITHM_SIMPLE 0
+#define NO2_ALGORITHM_1 1   // WEc = WEu - nT * AEu
+#define NO2_ALGORITHM_2 2   // WEc = WEu - kT * (WE0 / AE0) * AEu
+#define NO2_ALGORITHM_3 3   // WEc = WEu - (WE0 - AE0) - k'T * AEu
+#define NO2_ALGORITHM_4 4   // WEc = WEu - WE0 - k''T
+
+#ifndef NO2_ALGORITHM
+#define NO2_ALGORITHM NO2_ALGORITHM_SIMPLE
+#endif
+
+/* 
+ * Temperature correction factors for the NO2-A43F from AAN 803 
+ * (-30 °C to 50 °C in steps of 10 °C). Check them against the 
+ * revision of the application note that is shipped with the sensor.
+ */
+const int no2_table_size = 9;
+const float no2_table_min_temperature = -30;
+const float no2_table_step_inverse = 0.1F;
+
+constexpr float no2_n_t[no2_table_size]   = { 1.18, 1.18, 1.18, 1.18, 1.18, 1.18, 1.18, 2.00, 2.70 };
+constexpr float no2_k_t[no2_table_size]   = { 0.18, 0.18, 0.18, 0.18, 0.18, 0.18, 0.18, 0.30, 0.40 };
+constexpr float no2_k1_t[no2_table_size]  = { 0.03, 0.03, 0.03, 0.03, 0.03, 0.03, 0.03, 0.49, 0.76 };
+constexpr float no2_k2_t[no2_table_size]  = { 0.90, 0.90, 0.90, 0.90, 0.90, 0.90, 0.90, 1.70, 2.90 };
+
+/* 
+ * Linear interpolation in one of the tables above. The tables have a 
+ * constant step so the index is calculated directly (no search).
+ */
+inline float no2_interpolate(const float *table, float temperature)
+{
+    float x = (temperature - no2_table_min_temperature) * no2_table_step_inverse;
+    if (!(x > 0))
+    {
+        // also catches NaN from a failed temperature reading
+        return table[0];
+    }
+    if (x >= no2_table_size - 1)
+    {
+        return table[no2_table_size - 1];
+    }
+    int i = (int) x;
+    float f = x - i;
+    return table[i] + f * (table[i + 1] - table[i]);
+}
+
+inline float no2_ppb(const NO2Sensor &sensor, float we_corrected)
+{
+    if (we_corrected < 0)
+    {
+        return 0;
+    }
+    return we_corrected / sensor.sensitivity;
+}
+
+template <int algorithm> struct NO2Algorithm;
+
+/* 
+ * Simple ppb calculation (see alphasense datasheet), no temperature compensation
+ */
+template <> struct NO2Algorithm<NO2_ALGORITHM_SIMPLE>
+{
+    static float ppb(const NO2Sensor &sensor, float we, float ae, float /* temperature */)
+    {
+        float c = we - sensor.we_zero_total;
+        if (c < 0) 
+        {
+            c = 0;
+        }
+
+        float e = ae - sensor.ae_zero_total;
+        if (e < 0)
+        {
+            e = 0;
+        }
+
+        return no2_ppb(sensor, c - e);
+    }
+};
+
+template <> struct NO2Algorithm<NO2_ALGORITHM_1>
+{
+    static float ppb(const NO2Sensor &sensor, float we, float ae, float temperature)
+    {
+        float we_u = we - sensor.we_zero_electronic;
+        float ae_u = ae - sensor.ae_zero_electronic;
+        return no2_ppb(sensor, we_u - no2_interpolate(no2_n_t, temperature) * ae_u);
+    }
+};
+
+template <> struct NO2Algorithm<NO2_ALGORITHM_2>
+{
+    static float ppb(const NO2Sensor &sensor, float we, float ae, float temperature)
+    {
+        float we_u = we - sensor.we_zero_electronic;
+        float ae_u = ae - sensor.ae_zero_electronic;
+        float we_0 = sensor.we_zero_total - sensor.we_zero_electronic;
+        float ae_0 = sensor.ae_zero_total - sensor.ae_zero_electronic;
+        float ratio = ae_0 != 0 ? we_0 / ae_0 : 1;
+        return no2_ppb(sensor, we_u - no2_interpolate(no2_k_t, temperature) * ratio * ae_u);
+    }
+};
+
+template <> struct NO2Algorithm<NO2_ALGORITHM_3>
+{
+    static float ppb(const NO2Sensor &sensor, float we, float ae, float temperature)
+    {
+        float we_u = we - sensor.we_zero_electronic;
+        float ae_u = ae - sensor.ae_zero_electronic;
+        float we_0 = sensor.we_zero_total - sensor.we_zero_electronic;
+        float ae_0 = sensor.ae_zero_total - sensor.ae_zero_electronic;
+        return no2_ppb(sensor, we_u - (we_0 - ae_0) - no2_interpolate(no2_k1_t, temperature) * ae_u);
+    }
+};
+
+template <> struct NO2Algorithm<NO2_ALGORITHM_4>
+{
+    static float ppb(const NO2Sensor &sensor, float we, float /* ae */, float temperature)
+    {
+        float we_u = we - sensor.we_zero_electronic;
+        float we_0 = sensor.we_zero_total - sensor.we_zero_electronic;
+        return no2_ppb(sensor, we_u - we_0 - no2_interpolate(no2_k2_t, temperature));
+    }
+};
+
+#endif
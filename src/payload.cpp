@@ -0,0 +1,437 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "payload.h"
+
+ByteWriter::ByteWriter(uint8_t *_buffer, int _size)
+{
+    buffer = _buffer;
+    size = _size;
+}
+
+bool ByteWriter::write(uint8_t value)
+{
+    if (position >= size)
+    {
+        // keep counting, so the caller knows the required size
+        position++;
+        return false;
+    }
+    buffer[position++] = value;
+    return true;
+}
+
+bool ByteWriter::writeVarint(uint32_t value)
+{
+    bool success = true;
+    while (value >= 0x80)
+    {
+        success &= write((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    return write(value) && success;
+}
+
+bool ByteWriter::writeZigzag(int32_t value)
+{
+    return writeVarint(((uint32_t) value << 1) ^ (uint32_t) (value >> 31));
+}
+
+int ByteWriter::bytes()
+{
+    return position;
+}
+
+ByteReader::ByteReader(const uint8_t *_buffer, int _size)
+{
+    buffer = _buffer;
+    size = _size;
+}
+
+uint8_t ByteReader::read()
+{
+    if (position >= size)
+    {
+        overflowed = true;
+        return 0;
+    }
+    return buffer[position++];
+}
+
+uint32_t ByteReader::readVarint()
+{
+    uint32_t value = 0;
+    for (int shift = 0; shift < 35; shift += 7)
+    {
+        uint8_t b = read();
+        value |= (uint32_t) (b & 0x7F) << shift;
+        if (!(b & 0x80))
+        {
+            break;
+        }
+    }
+    return value;
+}
+
+int32_t ByteReader::readZigzag()
+{
+    uint32_t value = readVarint();
+    return (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+}
+
+bool ByteReader::overflow()
+{
+    return overflowed;
+}
+
+/* 
+ * Seconds since payload_epoch of the GPS date/time fields (days from civil, 
+ * see http://howardhinnant.github.io/date_algorithms.html)
+ */
+uint32_t payload_timestamp(EnvironmentData *data)
+{
+    if (data->gps_year < 2018 || data->gps_month < 1 || data->gps_month > 12 || data->gps_day < 1)
+    {
+        return 0xFFFFFFFF;
+    }
+
+    int32_t y = data->gps_year - (data->gps_month <= 2 ? 1 : 0);
+    int32_t era = y / 400;
+    int32_t yoe = y - era * 400;
+    int32_t doy = (153 * (data->gps_month + (data->gps_month > 2 ? -3 : 9)) + 2) / 5 + data->gps_day - 1;
+    int32_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    int32_t days = era * 146097 + doe - 719468;
+
+    uint32_t seconds = (uint32_t) days * 86400UL + data->gps_hour * 3600UL 
+        + data->gps_minute * 60UL + data->gps_second;
+    return seconds - payload_epoch;
+}
+
+void payload_datetime(uint32_t timestamp, EnvironmentData *data)
+{
+    uint32_t seconds = timestamp + payload_epoch;
+    int32_t days = seconds / 86400UL;
+    uint32_t time = seconds % 86400UL;
+
+    int32_t z = days + 719468;
+    int32_t era = z / 146097;
+    int32_t doe = z - era * 146097;
+    int32_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    int32_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    int32_t mp = (5 * doy + 2) / 153;
+    int32_t month = mp < 10 ? mp + 3 : mp - 9;
+
+    data->gps_year = yoe + era * 400 + (month <= 2 ? 1 : 0);
+    data->gps_month = month;
+    data->gps_day = doy - (153 * mp + 2) / 5 + 1;
+    data->gps_hour = time / 3600;
+    data->gps_minute = time / 60 % 60;
+    data->gps_second = time % 60;
+}
+
+double payload_seconds(EnvironmentData &data)
+{
+    uint32_t timestamp = payload_timestamp(&data);
+    return timestamp == 0xFFFFFFFF ? NAN : timestamp;
+}
+
+void payload_set_seconds(EnvironmentData &data, double value)
+{
+    if (!isnan(value))
+    {
+        payload_datetime(value, &data);
+    }
+}
+
+// no GPS fix (0/0) is not available
+double payload_latitude(EnvironmentData &data)
+{
+    return data.gps_latitude == 0 && data.gps_longitude == 0 ? NAN : data.gps_latitude;
+}
+
+void payload_set_latitude(EnvironmentData &data, double value)
+{
+    if (!isnan(value))
+    {
+        data.gps_latitude = value;
+    }
+}
+
+double payload_longitude(EnvironmentData &data)
+{
+    return data.gps_latitude == 0 && data.gps_longitude == 0 ? NAN : data.gps_longitude;
+}
+
+void payload_set_longitude(EnvironmentData &data, double value)
+{
+    if (!isnan(value))
+    {
+        data.gps_longitude = value;
+    }
+}
+
+// no calibration (version 0) and a record which was not downsampled are not sent
+double payload_calibration(EnvironmentData &data)
+{
+    return data.calibration_version == 0 ? NAN : data.calibration_version;
+}
+
+double payload_samples(EnvironmentData &data)
+{
+    return data.samples <= 1 ? NAN : data.samples;
+}
+
+#define PAYLOAD_FIELD_GET(name, bits, resolution, offset, is_signed, get, set) \
+    values[PAYLOAD_##name] = get;
+#define PAYLOAD_FIELD_SET(name, bits, resolution, offset, is_signed, get, set) \
+    { double value = values[PAYLOAD_##name]; set; }
+
+/* 
+ * Values of all fields in the order of the schema (see payloadschema.h)
+ */
+void EnvironmentData::payload_values(double *values)
+{
+    EnvironmentData &data = *this;
+    PAYLOAD_SCHEMA(PAYLOAD_FIELD_GET)
+}
+
+void EnvironmentData::from_payload_values(const double *values)
+{
+    EnvironmentData &data = *this;
+    PAYLOAD_SCHEMA(PAYLOAD_FIELD_SET)
+}
+
+/* 
+ * Quantized values of all fields (steps of the resolution)
+ */
+void EnvironmentData::payload_fields(int32_t *values)
+{
+    double physical[payload_field_count];
+    payload_values(physical);
+    for (int i = 0; i < payload_field_count; i++)
+    {
+        values[i] = payload_steps(i, physical[i]);
+    }
+}
+
+void EnvironmentData::from_payload_fields(const int32_t *values)
+{
+    double physical[payload_field_count];
+    for (int i = 0; i < payload_field_count; i++)
+    {
+        physical[i] = payload_value(i, values[i]);
+    }
+    from_payload_values(physical);
+}
+
+int EnvironmentData::lora_payload(uint8_t *buffer)
+{
+    double values[payload_field_count];
+    payload_values(values);
+    return payload_encode(values, buffer);
+}
+
+bool EnvironmentData::from_lora_payload(const uint8_t *buffer, int length)
+{
+    double values[payload_field_count];
+    if (!payload_decode(buffer, length, values))
+    {
+        return false;
+    }
+    from_payload_values(values);
+    return true;
+}
+
+/* 
+ * Encodes the first records which fit into the buffer, returns the number of encoded 
+ * records and the length of the payload
+ */
+int payload_encode_batch(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length)
+{
+    memset(buffer, 0, size);
+    int position = 8;
+    int n = 0;
+    for (; n < count && n < payload_batch_max; n++)
+    {
+        int32_t steps[payload_field_count];
+        records[n].payload_fields(steps);
+        if (position + payload_record_bits(steps) > size * 8)
+        {
+            break;
+        }
+        payload_put_record(buffer, position, steps);
+    }
+    buffer[0] = (PAYLOAD_VERSION << 4) | n;
+    *length = (position + 7) / 8;
+    return n;
+}
+
+int payload_decode_batch(const uint8_t *buffer, int length, EnvironmentData *records, int max)
+{
+    if (length < 1 || (buffer[0] >> 4) != PAYLOAD_VERSION)
+    {
+        return 0;
+    }
+    int count = buffer[0] & 0x0F;
+    int position = 8;
+    for (int i = 0; i < count; i++)
+    {
+        int32_t steps[payload_field_count];
+        if (!payload_get_record(buffer, length, position, steps))
+        {
+            return 0;
+        }
+        if (i < max)
+        {
+            records[i].from_payload_fields(steps);
+        }
+    }
+    return count < max ? count : max;
+}
+
+/* 
+ * Compressed batch of the first "count" records with the fields of the bitmap "fields",
+ * returns the number of bytes needed (more than the size of the buffer if the records do not fit)
+ */
+static int payload_write_compressed(EnvironmentData *records, int count, uint8_t *buffer, int size, uint16_t fields)
+{
+    int32_t values[payload_batch_max][payload_field_count];
+    for (int i = 0; i < count; i++)
+    {
+        records[i].payload_fields(values[i]);
+    }
+
+    uint16_t present = 0;
+    uint16_t constant = 0;
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        bool isPresent = false;
+        bool isConstant = true;
+        for (int i = 0; i < count; i++)
+        {
+            isPresent |= values[i][field] != payload_missing(field);
+            isConstant &= values[i][field] == values[0][field];
+        }
+        present |= isPresent && (fields & (1 << field)) ? 1 << field : 0;
+        constant |= isConstant ? 1 << field : 0;
+    }
+
+    ByteWriter writer(buffer, size);
+    writer.write((PAYLOAD_VERSION << 4) | count);
+    writer.write(present & 0xFF);
+    writer.write(present >> 8);
+    writer.write(constant & 0xFF);
+    writer.write(constant >> 8);
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        if (present & (1 << field))
+        {
+            writer.writeZigzag(values[0][field]);
+        }
+    }
+
+    int32_t interval = 0;
+    for (int i = 1; i < count; i++)
+    {
+        for (int field = 0; field < payload_field_count; field++)
+        {
+            if (!(present & (1 << field)) || (constant & (1 << field)))
+            {
+                continue;
+            }
+            int32_t delta = values[i][field] - values[i - 1][field];
+            if (field == PAYLOAD_timestamp)
+            {
+                writer.writeZigzag(delta - interval);
+                interval = delta;
+            }
+            else
+            {
+                writer.writeZigzag(delta);
+            }
+        }
+    }
+    return writer.bytes();
+}
+
+/* 
+ * Encodes as many records as fit into the buffer, returns the number of encoded records
+ * (the fields which are not in the bitmap "fields" are sent as not available)
+ */
+int payload_encode_compressed(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length, uint16_t fields)
+{
+    if (count > payload_batch_max)
+    {
+        count = payload_batch_max;
+    }
+
+    // the bitmaps depend on all records of the frame, so try the largest batch first
+    for (; count > 0; count--)
+    {
+        *length = payload_write_compressed(records, count, buffer, size, fields);
+        if (*length <= size)
+        {
+            return count;
+        }
+    }
+    *length = 0;
+    return 0;
+}
+
+int payload_decode_compressed(const uint8_t *buffer, int length, EnvironmentData *records, int max)
+{
+    ByteReader reader(buffer, length);
+    uint8_t header = reader.read();
+    if ((header >> 4) != PAYLOAD_VERSION)
+    {
+        return 0;
+    }
+    int count = header & 0x0F;
+    uint16_t present = reader.read();
+    present |= reader.read() << 8;
+    uint16_t constant = reader.read();
+    constant |= reader.read() << 8;
+
+    int32_t values[payload_field_count];
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        values[field] = (present & (1 << field)) ? reader.readZigzag() : payload_missing(field);
+    }
+
+    int32_t interval = 0;
+    for (int i = 0; i < count; i++)
+    {
+        if (i > 0)
+        {
+            for (int field = 0; field < payload_field_count; field++)
+            {
+                if (!(present & (1 << field)) || (constant & (1 << field)))
+                {
+                    continue;
+                }
+                if (field == PAYLOAD_timestamp)
+                {
+                    interval += reader.readZigzag();
+                    values[field] += interval;
+                }
+                else
+                {
+                    values[field] += reader.readZigzag();
+                }
+            }
+        }
+        if (i < max)
+        {
+            records[i].from_payload_fields(values);
+        }
+    }
+    if (reader.overflow())
+    {
+        return 0;
+    }
+    return count < max ? count : max;
+}
@@ -0,0 +1,99 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Bit-packed binary uplink payload (replaces the 44 character ascii lora-message).
+ * 
+ * Single payload: the version (4 bit) followed by the presence bitmap (one bit per field)
+ * and the available fields of PAYLOAD_SCHEMA (see payloadschema.h) MSB first without any
+ * padding between them.
+ * 
+ * Batch payload (backlog after an outage): one header byte with the version (4 bit) and the 
+ * number of records (4 bit), followed by the records above without their version field.
+ * As many records as fit into the frame of the current datarate are sent in one uplink.
+ * 
+ * Compressed batch payload (same fields and resolutions, byte aligned):
+ *   header        1 byte  version (4 bit) and number of records (4 bit)
+ *   present       2 bytes bitmap of the fields which are sent (LSB first, bit 0 = temperature, ...)
+ *   constant      2 bytes bitmap of the fields which have the same value in all records
+ *   first record          zigzag varint of every present field
+ *   next records          zigzag varint of the difference to the previous record for every 
+ *                         present field which is not constant (the timestamp is sent as the 
+ *                         difference to the previous measurement interval)
+ * A parked sensor with a constant measurement interval needs about 8 bytes per record.
+ */
+
+#ifndef _payload_h_
+#define _payload_h_
+
+#include "measurement.h"
+#include "payloadschema.h"
+
+const uint8_t payload_port = 2;     // ascii lora-message was sent on port 1
+const uint8_t payload_batch_port = 3;
+const uint8_t payload_compressed_port = 4;
+const int payload_batch_max = 15;
+const int payload_batch_size_max = 255;
+const uint32_t payload_epoch = 1514764800; // 2018-01-01 00:00:00
+
+// field bitmaps of the compressed batch (bit = 1 << PAYLOAD_<name>), the essential fields
+// are needed for the NO2 calibration, the position is dropped first when the node cannot keep up
+const uint16_t payload_fields_all = (1 << payload_field_count) - 1;
+const uint16_t payload_fields_essential = payload_fields_all & ~((1 << PAYLOAD_latitude) | (1 << PAYLOAD_longitude));
+
+int payload_encode_batch(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length);
+int payload_decode_batch(const uint8_t *buffer, int length, EnvironmentData *records, int max);
+
+/* 
+ * Writes single bytes and zigzag varints (7 bit per byte, LSB first) into a byte buffer
+ */
+class ByteWriter
+{
+public:
+    ByteWriter(uint8_t *_buffer, int _size);
+    bool write(uint8_t value);
+    bool writeVarint(uint32_t value);
+    bool writeZigzag(int32_t value);
+    int bytes();
+private:
+    uint8_t *buffer;
+    int size;
+    int position = 0;
+};
+
+/* 
+ * Reads the values written by ByteWriter
+ */
+class ByteReader
+{
+public:
+    ByteReader(const uint8_t *_buffer, int _size);
+    uint8_t read();
+    uint32_t readVarint();
+    int32_t readZigzag();
+    bool overflow();
+private:
+    const uint8_t *buffer;
+    int size;
+    int position = 0;
+    bool overflowed = false;
+};
+
+int payload_encode_compressed(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length, uint16_t fields = payload_fields_all);
+int payload_decode_compressed(const uint8_t *buffer, int length, EnvironmentData *records, int max);
+uint32_t payload_timestamp(EnvironmentData *data);
+void payload_datetime(uint32_t timestamp, EnvironmentData *data);
+
+// values of the schema fields which are not a single member of EnvironmentData
+double payload_seconds(EnvironmentData &data);
+void payload_set_seconds(EnvironmentData &data, double value);
+double payload_latitude(EnvironmentData &data);
+void payload_set_latitude(EnvironmentData &data, double value);
+double payload_longitude(EnvironmentData &data);
+void payload_set_longitude(EnvironmentData &data, double value);
+double payload_calibration(EnvironmentData &data);
+double payload_samples(EnvironmentData &data);
+
+#endif
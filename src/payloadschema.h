@@ -0,0 +1,274 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Single source of the uplink payload layout.
+ *
+ * Every line of PAYLOAD_SCHEMA is one field in the order of the payload:
+ *   FIELD(name, bits, resolution, offset, signed, value of the EnvironmentData "data",
+ *         assignment of the decoded "value" to "data")
+ * The raw value of a field is (value - offset) / resolution. All bits set (unsigned) or
+ * the smallest value (signed) is reserved for "not available" (NaN), values outside of
+ * the range are clamped.
+ *
+ * A record of the single and the batch payload starts with a presence bitmap (one bit per
+ * field), only the available fields follow it, so a field which is not sent (a missing
+ * sensor board, no calibration, a record which was not downsampled) costs one bit.
+ * The encoder of the device and the decoder are generated from this list. The header does
+ * not depend on Arduino and can be used on the host to decode uplinks. The TTN payload
+ * formatter (ttn/payload-formatter.js) is generated from this list at build time by
+ * tools/payload_schema.py. Adding a field is one line here and a new PAYLOAD_VERSION.
+ */
+
+#ifndef _payloadschema_h_
+#define _payloadschema_h_
+
+#include <stdint.h>
+#include <math.h>
+
+#define PAYLOAD_VERSION 6
+
+#define PAYLOAD_SCHEMA(FIELD) \
+    FIELD(temperature, 11, 0.1,     -40,   false, data.sht31_temperature,   data.sht31_temperature = value) \
+    FIELD(humidity,    8,  0.5,     0,     false, data.sht31_humidity,      data.sht31_humidity = value) \
+    FIELD(pressure,    12, 0.1,     800,   false, data.bmp180_pressure,     data.bmp180_pressure = value) \
+    FIELD(timestamp,   30, 1,       0,     false, payload_seconds(data),    payload_set_seconds(data, value)) \
+    FIELD(latitude,    20, 0.00001, 48.15, true,  payload_latitude(data),   payload_set_latitude(data, value)) \
+    FIELD(longitude,   20, 0.00001, 11.54, true,  payload_longitude(data),  payload_set_longitude(data, value)) \
+    FIELD(ae,          15, 0.03125, 0,     false, data.no2_ae,              data.no2_ae = value) \
+    FIELD(we,          15, 0.03125, 0,     false, data.no2_we,              data.no2_we = value) \
+    FIELD(we_stddev,   10, 0.03125, 0,     false, data.no2_we_stddev,       data.no2_we_stddev = value) \
+    FIELD(ae_stddev,   10, 0.03125, 0,     false, data.no2_ae_stddev,       data.no2_ae_stddev = value) \
+    FIELD(o3,          11, 0.5,     0,     false, data.o3_ppb,              data.o3_ppb = value) \
+    FIELD(co,          14, 1,       0,     false, data.co_ppb,              data.co_ppb = value) \
+    FIELD(ugm3,        13, 0.1,     0,     false, data.no2_ugm3,            data.no2_ugm3 = value) \
+    FIELD(calibration, 12, 1,       0,     false, payload_calibration(data), data.calibration_version = isnan(value) ? 0 : value) \
+    FIELD(samples,     10, 1,       0,     false, payload_samples(data),    data.samples = isnan(value) ? 1 : value)
+
+/*
+ * Descriptor of one field, the table payload_schema is generated from PAYLOAD_SCHEMA
+ */
+struct PayloadFieldSpec
+{
+    const char *name;
+    uint8_t bits;
+    double resolution;
+    double offset;
+    bool is_signed;
+};
+
+#define PAYLOAD_FIELD_SPEC(name, bits, resolution, offset, is_signed, get, set) \
+    { #name, bits, resolution, offset, is_signed },
+#define PAYLOAD_FIELD_ENUM(name, bits, resolution, offset, is_signed, get, set) \
+    PAYLOAD_##name,
+
+enum PayloadField
+{
+    PAYLOAD_SCHEMA(PAYLOAD_FIELD_ENUM)
+    PAYLOAD_FIELD_COUNT
+};
+
+constexpr int payload_field_count = PAYLOAD_FIELD_COUNT;
+static_assert(payload_field_count <= 16, "the field bitmaps of the compressed batch have 16 bits");
+constexpr PayloadFieldSpec payload_schema[payload_field_count] = { PAYLOAD_SCHEMA(PAYLOAD_FIELD_SPEC) };
+
+/*
+ * Largest number of bits of a record (presence bitmap and all fields) and the size of the
+ * single payload with all fields (after the 4 bit version)
+ */
+constexpr int payload_record_bits_of(int field)
+{
+    return field == 0 ? payload_field_count : payload_record_bits_of(field - 1) + payload_schema[field - 1].bits;
+}
+
+constexpr int payload_record_bits_max = payload_record_bits_of(payload_field_count);
+constexpr int payload_size_max = (4 + payload_record_bits_max + 7) / 8;
+
+/*
+ * Quantized value of a field in steps of its resolution and back (the ranges are
+ * constants of the schema, so they are folded for a constant field)
+ */
+inline int32_t payload_missing(int field)
+{
+    return payload_schema[field].is_signed ? -(1L << (payload_schema[field].bits - 1)) 
+        : (int32_t) ((1UL << payload_schema[field].bits) - 1);
+}
+
+inline int32_t payload_steps(int field, double value)
+{
+    int bits = payload_schema[field].bits;
+    int32_t minimum = payload_schema[field].is_signed ? -(1L << (bits - 1)) + 1 : 0;
+    int32_t maximum = payload_schema[field].is_signed ? (1L << (bits - 1)) - 1 : (int32_t) ((1UL << bits) - 2);
+
+    if (isnan(value))
+    {
+        return payload_missing(field);
+    }
+    double steps = floor((value - payload_schema[field].offset) / payload_schema[field].resolution + 0.5);
+    if (steps < minimum)
+    {
+        return minimum;
+    }
+    if (steps > maximum)
+    {
+        return maximum;
+    }
+    return (int32_t) steps;
+}
+
+inline double payload_value(int field, int32_t steps)
+{
+    if (steps == payload_missing(field))
+    {
+        return NAN;
+    }
+    return steps * payload_schema[field].resolution + payload_schema[field].offset;
+}
+
+/*
+ * Raw bits of a field (two's complement cut to the bits for signed fields) and back
+ */
+inline uint32_t payload_raw(int field, int32_t steps)
+{
+    return (uint32_t) steps & ((1UL << payload_schema[field].bits) - 1);
+}
+
+inline int32_t payload_steps_of_raw(int field, uint32_t raw)
+{
+    int bits = payload_schema[field].bits;
+    if (payload_schema[field].is_signed && (raw & (1UL << (bits - 1))))
+    {
+        raw |= ~((1UL << bits) - 1);
+    }
+    return (int32_t) raw;
+}
+
+/*
+ * Writes/reads "bits" bits at the bit position "position" (MSB first) and advances it
+ */
+inline void payload_put(uint8_t *buffer, int &position, uint32_t value, int bits)
+{
+    for (int i = bits - 1; i >= 0; i--, position++)
+    {
+        if (value & (1UL << i))
+        {
+            buffer[position >> 3] |= 0x80 >> (position & 7);
+        }
+    }
+}
+
+inline uint32_t payload_get(const uint8_t *buffer, int &position, int bits)
+{
+    uint32_t value = 0;
+    for (int i = 0; i < bits; i++, position++)
+    {
+        value = (value << 1) | ((buffer[position >> 3] >> (7 - (position & 7))) & 1);
+    }
+    return value;
+}
+
+/*
+ * Number of bits of a record with the quantized values "steps": one presence bit per
+ * field and the fields which are available
+ */
+inline int payload_record_bits(const int32_t *steps)
+{
+    int bits = payload_field_count;
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        bits += steps[field] != payload_missing(field) ? payload_schema[field].bits : 0;
+    }
+    return bits;
+}
+
+/*
+ * Record of the single and the batch payload: the presence bitmap (one bit per field in
+ * the order of the schema, 1 = available) followed by the available fields, so a field
+ * which is not available costs one bit. The buffer must be zeroed.
+ */
+inline void payload_put_record(uint8_t *buffer, int &position, const int32_t *steps)
+{
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        payload_put(buffer, position, steps[field] != payload_missing(field), 1);
+    }
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        if (steps[field] != payload_missing(field))
+        {
+            payload_put(buffer, position, payload_raw(field, steps[field]), payload_schema[field].bits);
+        }
+    }
+}
+
+/*
+ * Reads a record of "length" bytes, returns false if the record is longer
+ */
+inline bool payload_get_record(const uint8_t *buffer, int length, int &position, int32_t *steps)
+{
+    if (position + payload_field_count > length * 8)
+    {
+        return false;
+    }
+    uint32_t present = payload_get(buffer, position, payload_field_count);
+    int bits = 0;
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        if (present & (1UL << (payload_field_count - 1 - field)))
+        {
+            bits += payload_schema[field].bits;
+        }
+    }
+    if (position + bits > length * 8)
+    {
+        return false;
+    }
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        steps[field] = present & (1UL << (payload_field_count - 1 - field))
+            ? payload_steps_of_raw(field, payload_get(buffer, position, payload_schema[field].bits))
+            : payload_missing(field);
+    }
+    return true;
+}
+
+/*
+ * Single payload: values in the order of the schema (NaN = not available), returns the
+ * length of the payload. The buffer must have payload_size_max bytes.
+ */
+inline int payload_encode(const double *values, uint8_t *buffer)
+{
+    int32_t steps[payload_field_count];
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        steps[field] = payload_steps(field, values[field]);
+    }
+    for (int i = 0; i < payload_size_max; i++)
+    {
+        buffer[i] = 0;
+    }
+    int position = 0;
+    payload_put(buffer, position, PAYLOAD_VERSION, 4);
+    payload_put_record(buffer, position, steps);
+    return (position + 7) / 8;
+}
+
+inline bool payload_decode(const uint8_t *buffer, int length, double *values)
+{
+    int position = 0;
+    int32_t steps[payload_field_count];
+    if (length < 1 || payload_get(buffer, position, 4) != PAYLOAD_VERSION 
+        || !payload_get_record(buffer, length, position, steps))
+    {
+        return false;
+    }
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        values[field] = payload_value(field, steps[field]);
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,476 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "persistentqueue.h"
+#include "payloadschema.h"
+
+#include <rom/crc.h>
+
+struct QueueSlot
+{
+    uint32_t sequence;
+    MeasurementRecord record;
+    uint32_t crc;
+};
+
+struct QueueTail
+{
+    uint32_t value;
+    uint32_t inverse;
+};
+
+static_assert(sizeof(QueueSlot) == PersistentQueue::slotSize, "QueueSlot must fill a slot");
+
+// slots/entries read at once at startup (the loop task has a small stack)
+static const int queue_chunk = 8;
+
+// largest number of samples of a merged record (the samples field of the uplink)
+static const uint32_t queue_samples_max = (1UL << payload_schema[PAYLOAD_samples].bits) - 2;
+
+static uint32_t queue_crc(QueueSlot *slot)
+{
+    return crc32_le(0, (const uint8_t *) slot, offsetof(QueueSlot, crc));
+}
+
+static bool queue_erased(const uint8_t *data, int length)
+{
+    for (int i = 0; i < length; i++)
+    {
+        if (data[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 
+ * Opens the queue on the partition "label", interval is the time between two 
+ * measurements in seconds (the smallest time bucket of the downsampling)
+ */
+bool PersistentQueue::begin(const char *label, uint32_t interval)
+{
+    measurementInterval = interval > 0 ? interval : 1;
+    partition = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_ANY, label);
+    if (partition == NULL)
+    {
+        Serial.printf("(I) - queue partition '%s' not found\n", label);
+        return false;
+    }
+    slotCount = (partition->size / sectorSize - metaSectors) * slotsPerSector;
+
+    loadTail();
+
+    // the head follows the highest valid sequence number (records of older rounds are ignored)
+    bool found = false;
+    uint32_t highest = 0;
+    QueueSlot slots[queue_chunk];
+    for (int first = 0, n = 0; first < slotCount; first += n)
+    {
+        // the chunks end at the end of a sector
+        n = slotsPerSector - first % slotsPerSector < queue_chunk ? slotsPerSector - first % slotsPerSector : queue_chunk;
+        size_t offset = slotOffset(first);
+        if (esp_partition_read(partition, offset, slots, n * slotSize) != ESP_OK)
+        {
+            readErrors++;
+            continue;
+        }
+        for (int i = 0; i < n; i++)
+        {
+            QueueSlot &slot = slots[i];
+            if (slot.crc == queue_crc(&slot) && slotOffset(slot.sequence) == offset + i * slotSize
+                && (!found || (int32_t) (slot.sequence - highest) > 0))
+            {
+                highest = slot.sequence;
+                found = true;
+            }
+        }
+    }
+    head = found ? highest + 1 : tail;
+
+    // acknowledged records are never ahead of the head, lost records (older than one ring) are dropped
+    if (!found || (int32_t) (tail - head) > 0)
+    {
+        tail = head;
+    }
+    if (head - tail > (uint32_t) (slotCount - slotsPerSector))
+    {
+        tail = head - (slotCount - slotsPerSector);
+    }
+
+    return recover();
+}
+
+bool PersistentQueue::erased(size_t from, size_t to)
+{
+    QueueSlot slots[queue_chunk];
+    for (size_t position = from; position < to; position += sizeof(slots))
+    {
+        int length = to - position < sizeof(slots) ? to - position : sizeof(slots);
+        if (esp_partition_read(partition, position, slots, length) != ESP_OK || !queue_erased((uint8_t *) slots, length))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* 
+ * The slots from the head to the end of its sector must be erased, otherwise an 
+ * interrupted write left some bits. The torn slots after the head (an interrupted write
+ * and the holes skipped before it) are skipped: their sequence numbers read as unreadable
+ * records, which are dropped at the tail, so the records before them are never erased.
+ * A dirty sector without records (or with bits in its unused end) is erased, its records
+ * are rewritten.
+ */
+bool PersistentQueue::recover()
+{
+    size_t offset = slotOffset(head);
+    size_t sectorStart = offset - offset % sectorSize;
+    size_t sectorEnd = sectorStart + sectorSize;
+    if (erased(offset, sectorEnd))
+    {
+        return true;
+    }
+    if (offset > sectorStart && erased(sectorStart + slotsPerSector * slotSize, sectorEnd))
+    {
+        int first = (offset - sectorStart) / slotSize;
+        int skipped = 0;
+        for (int i = first; i < slotsPerSector; i++)
+        {
+            if (!erased(sectorStart + i * slotSize, sectorStart + (i + 1) * slotSize))
+            {
+                skipped = i + 1 - first;
+            }
+        }
+        Serial.printf("(I) - queue - skipping %d torn slots\n", skipped);
+        head += skipped;
+        // the skipped slots take places of the queue like records
+        int excess = count() - (slotCount - slotsPerSector);
+        if (excess > 0 && ack(excess))
+        {
+            droppedRecords += excess;
+            generationCount++;
+        }
+        return true;
+    }
+
+    Serial.println("(I) - queue - repairing interrupted write");
+    int used = offset - sectorStart;
+    uint8_t *sector = (uint8_t *) malloc(sectorSize);
+    bool success = sector != NULL
+        && esp_partition_read(partition, sectorStart, sector, used) == ESP_OK
+        && esp_partition_erase_range(partition, sectorStart, sectorSize) == ESP_OK
+        && (used == 0 || esp_partition_write(partition, sectorStart, sector, used) == ESP_OK);
+    free(sector);
+    if (!success)
+    {
+        writeErrors++;
+    }
+    return success;
+}
+
+void PersistentQueue::loadTail()
+{
+    bool found = false;
+    QueueTail entries[queue_chunk];
+    const int entryCount = sectorSize / sizeof(QueueTail);
+    for (int s = 0; s < metaSectors; s++)
+    {
+        for (int first = 0; first < entryCount; first += queue_chunk)
+        {
+            if (esp_partition_read(partition, s * sectorSize + first * sizeof(QueueTail), entries, sizeof(entries)) != ESP_OK)
+            {
+                readErrors++;
+                continue;
+            }
+            for (int i = 0; i < queue_chunk; i++)
+            {
+                QueueTail &entry = entries[i];
+                if (entry.inverse == ~entry.value && (!found || (int32_t) (entry.value - tail) > 0))
+                {
+                    tail = entry.value;
+                    found = true;
+                    metaSector = s;
+                    metaEntry = first + i + 1;
+                }
+            }
+        }
+    }
+    if (!found)
+    {
+        tail = 0;
+        metaSector = metaSectors - 1;
+        metaEntry = sectorSize / sizeof(QueueTail);
+    }
+}
+
+bool PersistentQueue::writeTail(uint32_t value)
+{
+    // an interrupted write may have left bits in the next entry, it is skipped
+    QueueTail entry;
+    while (metaEntry < sectorSize / (int) sizeof(QueueTail)
+        && (esp_partition_read(partition, metaSector * sectorSize + metaEntry * sizeof(QueueTail), &entry, sizeof(entry)) != ESP_OK
+            || !queue_erased((uint8_t *) &entry, sizeof(entry))))
+    {
+        metaEntry++;
+    }
+
+    // switch to the other sector when the active one is full, the last entry of the full 
+    // sector stays valid until the first entry of the new sector is written
+    if (metaEntry >= sectorSize / (int) sizeof(QueueTail))
+    {
+        metaSector = (metaSector + 1) % metaSectors;
+        metaEntry = 0;
+        if (esp_partition_erase_range(partition, metaSector * sectorSize, sectorSize) != ESP_OK)
+        {
+            writeErrors++;
+            return false;
+        }
+    }
+
+    entry = { value, ~value };
+    if (esp_partition_write(partition, metaSector * sectorSize + metaEntry * sizeof(QueueTail), &entry, sizeof(entry)) != ESP_OK)
+    {
+        writeErrors++;
+        return false;
+    }
+    metaEntry++;
+    return true;
+}
+
+size_t PersistentQueue::slotOffset(uint32_t sequence)
+{
+    uint32_t slot = sequence % slotCount;
+    return (metaSectors + slot / slotsPerSector) * sectorSize + (slot % slotsPerSector) * slotSize;
+}
+
+/* 
+ * Appends a record, a nearly full queue is downsampled first so the newest record is 
+ * never dropped (the oldest is dropped if no records can be merged)
+ */
+bool PersistentQueue::enqueue(MeasurementRecord *record)
+{
+    if (partition == NULL)
+    {
+        return false;
+    }
+    if (spaces() <= downsampleRecords && downsample(false) > 0)
+    {
+        downsample(true);
+    }
+    if (spaces() == 0 && ack(1))
+    {
+        droppedRecords++;
+        generationCount++;
+    }
+    return write(record);
+}
+
+bool PersistentQueue::write(MeasurementRecord *record)
+{
+    if (spaces() == 0)
+    {
+        return false;
+    }
+
+    size_t offset = slotOffset(head);
+    if (offset % sectorSize == 0 && esp_partition_erase_range(partition, offset, sectorSize) != ESP_OK)
+    {
+        writeErrors++;
+        return false;
+    }
+
+    QueueSlot slot;
+    slot.sequence = head;
+    slot.record = *record;
+    slot.crc = queue_crc(&slot);
+    if (esp_partition_write(partition, offset, &slot, sizeof(slot)) != ESP_OK)
+    {
+        writeErrors++;
+        // the slot may be partly written, it is skipped or its sector is repaired
+        recover();
+        return false;
+    }
+    head++;
+    return true;
+}
+
+// records without a date are only merged among themselves, the others only if they lie
+// within the time bucket of the merged record (2^k intervals for up to 2^k samples, the 
+// merged records at the head are out of time order, so the distance is taken both ways),
+// the ug/m3 of different calibration models are never averaged and the samples stay 
+// within the uplink field
+static bool queue_adjacent(const MeasurementRecord &a, const MeasurementRecord &b, uint32_t interval)
+{
+    uint32_t samples = a.samples + b.samples;
+    if (a.calibration_version != b.calibration_version || samples > queue_samples_max)
+    {
+        return false;
+    }
+    if (a.timestamp == 0xFFFFFFFF || b.timestamp == 0xFFFFFFFF)
+    {
+        return a.timestamp == b.timestamp;
+    }
+
+    uint32_t bucket = interval;
+    while (bucket < interval * samples)
+    {
+        bucket *= 2;
+    }
+    return (a.timestamp > b.timestamp ? a.timestamp - b.timestamp : b.timestamp - a.timestamp) < bucket;
+}
+
+/* 
+ * Merges the records of the oldest downsampleRecords pairwise (each with the next one of 
+ * the same time bucket) and appends them at the head, the originals are acknowledged 
+ * afterwards. Returns the number of merged pairs (only counted if "merge" is false).
+ */
+int PersistentQueue::downsample(bool merge)
+{
+    // the merged records need free slots until the originals are acknowledged, one is 
+    // kept for the new record
+    int available = count() < downsampleRecords ? count() : downsampleRecords;
+    if (available > spaces() - 1)
+    {
+        available = spaces() - 1;
+    }
+
+    // the records are kept in memory during the pass (too large for the stack of the loop task)
+    static MeasurementRecord records[downsampleRecords];
+    bool used[downsampleRecords];
+    int consumed = 0;
+    while (consumed < available && peek(consumed, &records[consumed]))
+    {
+        used[consumed++] = false;
+    }
+
+    // in time order, so the records of one bucket are next to each other (records without 
+    // a date stay in front)
+    for (int i = 1; i < consumed; i++)
+    {
+        MeasurementRecord record = records[i];
+        int j = i;
+        for (; j > 0 && records[j - 1].timestamp + 1 > record.timestamp + 1; j--)
+        {
+            records[j] = records[j - 1];
+        }
+        records[j] = record;
+    }
+
+    int pairs = 0;
+    for (int i = 0; i < consumed; i++)
+    {
+        if (used[i])
+        {
+            continue;
+        }
+        MeasurementRecord record = records[i];
+        for (int j = i + 1; j < consumed; j++)
+        {
+            if (!used[j] && queue_adjacent(record, records[j], measurementInterval))
+            {
+                record.merge(records[j]);
+                used[j] = true;
+                pairs++;
+                break;
+            }
+        }
+        if (merge && !write(&record))
+        {
+            return 0;
+        }
+    }
+
+    if (merge && ack(consumed))
+    {
+        mergedRecords += pairs;
+        generationCount++;
+        Serial.printf("(M) - queue - downsampled %d oldest records to %d\n", consumed, consumed - pairs);
+    }
+    return pairs;
+}
+
+bool PersistentQueue::readSlot(uint32_t sequence, MeasurementRecord *record)
+{
+    QueueSlot slot;
+    if (esp_partition_read(partition, slotOffset(sequence), &slot, sizeof(slot)) != ESP_OK 
+        || slot.sequence != sequence || slot.crc != queue_crc(&slot))
+    {
+        readErrors++;
+        return false;
+    }
+    *record = slot.record;
+    return true;
+}
+
+/* 
+ * Reads the record "index" (0 = oldest) without removing it
+ */
+bool PersistentQueue::peek(int index, MeasurementRecord *record)
+{
+    if (partition == NULL || index < 0 || index >= count())
+    {
+        return false;
+    }
+    // an unreadable oldest record would block the queue, it is dropped
+    while (index == 0 && count() > 0 && !readSlot(tail, record))
+    {
+        if (!ack(1))
+        {
+            return false;
+        }
+        generationCount++;
+    }
+    return count() > index && readSlot(tail + index, record);
+}
+
+/* 
+ * Removes the "count" oldest records (one flash write for the whole batch)
+ */
+bool PersistentQueue::ack(int count)
+{
+    if (partition == NULL || count <= 0)
+    {
+        return false;
+    }
+    if (count > this->count())
+    {
+        count = this->count();
+    }
+    if (!writeTail(tail + count))
+    {
+        return false;
+    }
+    tail += count;
+    return true;
+}
+
+int PersistentQueue::count()
+{
+    return head - tail;
+}
+
+/* 
+ * One sector is kept free, it is erased when the head enters it
+ */
+int PersistentQueue::spaces()
+{
+    int capacity = slotCount - slotsPerSector;
+    return capacity > count() ? capacity - count() : 0;
+}
+
+uint32_t PersistentQueue::generation()
+{
+    return generationCount;
+}
+
+void PersistentQueue::printInfo()
+{
+    Serial.printf("(S) - queue - records: %d, free: %d, head: %u, tail: %u, read/write errors: %u/%u, merged/dropped: %u/%u\n",
+        count(), spaces(), head, tail, readErrors, writeErrors, mergedRecords, droppedRecords);
+}
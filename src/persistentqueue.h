@@ -0,0 +1,85 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * FIFO of measurement records on a flash partition (partitions.csv), so the unsent
+ * measurements survive a reset or a brown-out of the powerbank.
+ *
+ * The first two sectors of the partition hold the tail (sequence number of the oldest
+ * unacknowledged record) as an append-only list of 8 byte entries (value and its
+ * complement). An acknowledge writes one entry, the active sector is switched when it
+ * is full. The other sectors are a ring of 48 byte slots (sequence number, record and
+ * CRC32, no slot crosses a sector), the slot of a record is its sequence number modulo 
+ * the number of slots. An enqueue writes one slot, a sector is erased when the head enters it.
+ *
+ * A slot or an entry is written with one flash write and is only valid with a matching
+ * CRC/complement, so an interrupted write loses at most the record or the acknowledge
+ * which was written. At startup the head is the slot after the highest valid sequence
+ * number and the tail is the highest valid entry, a torn slot at the head is skipped.
+ *
+ * When the queue is nearly full (outage of some days), the oldest records are downsampled
+ * instead of dropping the newest measurement: adjacent records of the oldest 
+ * downsampleRecords are merged pairwise into records of their mean (MeasurementRecord::merge) 
+ * and appended at the head (so they are sent after the newer records), then the originals 
+ * are acknowledged. Two records are only merged if they lie within a time bucket of 2^k 
+ * measurement intervals (k the smallest with 2^k >= the merged samples), so a record 
+ * stands for one bucket and never spans a gap of the measurements. Every pass halves the 
+ * resolution of the records it takes, so the queue keeps the whole outage and the latest 
+ * measurements at full resolution. An interrupted pass leaves the merged records and the 
+ * originals, nothing is lost.
+ *
+ * generation() changes whenever the queue removes records itself (downsampling, dropping
+ * the oldest or an unreadable record): the records read with peek before are stale then
+ * and must not be acknowledged by their old position.
+ */
+
+#ifndef _persistentqueue_h_
+#define _persistentqueue_h_
+
+#include <Arduino.h>
+#include <esp_partition.h>
+
+#include "record.h"
+
+class PersistentQueue
+{
+public:
+    static const int sectorSize = 4096;
+    static const int slotSize = 48;
+    static const int slotsPerSector = sectorSize / slotSize;
+    static const int metaSectors = 2;
+    static const int downsampleRecords = 64;
+    bool begin(const char *label, uint32_t interval);
+    bool enqueue(MeasurementRecord *record);
+    bool peek(int index, MeasurementRecord *record);
+    bool ack(int count);
+    int count();
+    int spaces();
+    uint32_t generation();
+    void printInfo();
+private:
+    const esp_partition_t *partition = NULL;
+    int slotCount = 0;
+    uint32_t measurementInterval = 0; // seconds
+    uint32_t head = 0;
+    uint32_t tail = 0;
+    int metaSector = 0;
+    int metaEntry = 0;
+    uint32_t writeErrors = 0;
+    uint32_t readErrors = 0;
+    uint32_t mergedRecords = 0;
+    uint32_t droppedRecords = 0;
+    uint32_t generationCount = 0;
+    size_t slotOffset(uint32_t sequence);
+    bool write(MeasurementRecord *record);
+    int downsample(bool merge);
+    bool readSlot(uint32_t sequence, MeasurementRecord *record);
+    bool erased(size_t from, size_t to);
+    bool recover();
+    void loadTail();
+    bool writeTail(uint32_t value);
+};
+
+#endif
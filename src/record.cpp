@@ -0,0 +1,200 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "record.h"
+#include "payload.h"
+
+static int16_t record_scale(float value, float resolution)
+{
+    if (isnan(value))
+    {
+        return record_missing;
+    }
+    float steps = roundf(value / resolution);
+    if (steps <= INT16_MIN)
+    {
+        return INT16_MIN + 1;
+    }
+    if (steps > INT16_MAX)
+    {
+        return INT16_MAX;
+    }
+    return (int16_t) steps;
+}
+
+static float record_value(int16_t steps, float resolution)
+{
+    return steps == record_missing ? NAN : steps * resolution;
+}
+
+// mean of two values weighted by their number of samples
+static int32_t record_mean(int32_t a, uint32_t aSamples, int32_t b, uint32_t bSamples)
+{
+    int64_t sum = (int64_t) a * aSamples + (int64_t) b * bSamples;
+    int64_t samples = aSamples + bSamples;
+    return (int32_t) ((sum + (sum >= 0 ? samples / 2 : -samples / 2)) / samples);
+}
+
+// a missing value has no weight
+static int16_t record_mean(int16_t a, uint32_t aSamples, int16_t b, uint32_t bSamples)
+{
+    if (a == record_missing)
+    {
+        return b;
+    }
+    if (b == record_missing)
+    {
+        return a;
+    }
+    return (int16_t) record_mean((int32_t) a, aSamples, (int32_t) b, bSamples);
+}
+
+// distance of the WE range from the mean in 0.5 mV (16 steps of 1/32 mV), rounded up
+static uint8_t record_range(int32_t distance)
+{
+    int32_t steps = (distance + 15) / 16;
+    if (steps < 0)
+    {
+        return 0;
+    }
+    return steps < record_range_missing ? steps : record_range_missing - 1;
+}
+
+// smallest and largest WE of a record (1/32 mV)
+static int32_t record_we_min(const MeasurementRecord &record)
+{
+    return record.no2_we - (record.no2_we_below != record_range_missing ? record.no2_we_below * 16 : 0);
+}
+
+static int32_t record_we_max(const MeasurementRecord &record)
+{
+    return record.no2_we + (record.no2_we_above != record_range_missing ? record.no2_we_above * 16 : 0);
+}
+
+// pooled standard deviation of two windows (the difference of their means is left out)
+static int16_t record_stddev(int16_t a, uint32_t aSamples, int16_t b, uint32_t bSamples)
+{
+    if (a == record_missing)
+    {
+        return b;
+    }
+    if (b == record_missing)
+    {
+        return a;
+    }
+    float variance = ((float) a * a * aSamples + (float) b * b * bSamples) / (aSamples + bSamples);
+    return (int16_t) lroundf(sqrtf(variance));
+}
+
+void MeasurementRecord::pack(EnvironmentData *data)
+{
+    timestamp = payload_timestamp(data);
+    latitude = lround(data->gps_latitude * 1e6);
+    longitude = lround(data->gps_longitude * 1e6);
+    temperature = record_scale(data->sht31_temperature, 0.01F);
+    humidity = record_scale(data->sht31_humidity, 0.01F);
+    pressure = record_scale(data->bmp180_pressure, 0.1F);
+    no2_ae = record_scale(data->no2_ae, 0.03125F);
+    no2_we = record_scale(data->no2_we, 0.03125F);
+    samples = data->samples > 0 ? data->samples : 1;
+    no2_we_stddev = record_scale(data->no2_we_stddev, 0.03125F);
+    no2_ae_stddev = record_scale(data->no2_ae_stddev, 0.03125F);
+    o3_ppb = record_scale(data->o3_ppb, 0.1F);
+    co_ppb = record_scale(data->co_ppb, 1);
+    no2_ugm3 = record_scale(data->no2_ugm3, 0.1F);
+    calibration_version = data->calibration_version;
+    no2_ppb = record_scale(data->no2_ppb, 0.1F);
+    no2_we_below = no2_we == record_missing ? record_range_missing 
+        : isnan(data->no2_we_min) ? 0 : record_range(lroundf((data->no2_we - data->no2_we_min) / 0.03125F));
+    no2_we_above = no2_we == record_missing ? record_range_missing 
+        : isnan(data->no2_we_max) ? 0 : record_range(lroundf((data->no2_we_max - data->no2_we) / 0.03125F));
+}
+
+void MeasurementRecord::unpack(EnvironmentData *data)
+{
+    *data = EnvironmentData();
+    if (timestamp != 0xFFFFFFFF)
+    {
+        payload_datetime(timestamp, data);
+    }
+    data->gps_latitude = latitude / 1e6;
+    data->gps_longitude = longitude / 1e6;
+    data->sht31_temperature = record_value(temperature, 0.01F);
+    data->sht31_humidity = record_value(humidity, 0.01F);
+    data->bmp180_pressure = record_value(pressure, 0.1F);
+    data->no2_ae = record_value(no2_ae, 0.03125F);
+    data->no2_we = record_value(no2_we, 0.03125F);
+    data->no2_ppb = record_value(no2_ppb, 0.1F);
+    data->samples = samples;
+    data->no2_we_stddev = record_value(no2_we_stddev, 0.03125F);
+    data->no2_ae_stddev = record_value(no2_ae_stddev, 0.03125F);
+    data->o3_ppb = record_value(o3_ppb, 0.1F);
+    data->co_ppb = record_value(co_ppb, 1);
+    data->no2_ugm3 = record_value(no2_ugm3, 0.1F);
+    data->calibration_version = calibration_version;
+    if (no2_we != record_missing && no2_we_below != record_range_missing && no2_we_above != record_range_missing)
+    {
+        data->no2_we_min = (no2_we - no2_we_below * 16) * 0.03125F;
+        data->no2_we_max = (no2_we + no2_we_above * 16) * 0.03125F;
+    }
+}
+
+/*
+ * Merges the next record into this one: the values, the position and the timestamp
+ * become the means of all measurements of both records, the noise the pooled noise and
+ * the WE range the range of both
+ */
+void MeasurementRecord::merge(const MeasurementRecord &next)
+{
+    uint32_t n = samples > 0 ? samples : 1;
+    uint32_t m = next.samples > 0 ? next.samples : 1;
+
+    if (timestamp == 0xFFFFFFFF || next.timestamp == 0xFFFFFFFF)
+    {
+        timestamp = timestamp == 0xFFFFFFFF ? next.timestamp : timestamp;
+    }
+    else
+    {
+        timestamp = ((uint64_t) timestamp * n + (uint64_t) next.timestamp * m + (n + m) / 2) / (n + m);
+    }
+
+    if (latitude == 0 && longitude == 0)
+    {
+        latitude = next.latitude;
+        longitude = next.longitude;
+    }
+    else if (next.latitude != 0 || next.longitude != 0)
+    {
+        latitude = record_mean(latitude, n, next.latitude, m);
+        longitude = record_mean(longitude, n, next.longitude, m);
+    }
+
+    temperature = record_mean(temperature, n, next.temperature, m);
+    humidity = record_mean(humidity, n, next.humidity, m);
+    pressure = record_mean(pressure, n, next.pressure, m);
+
+    // WE range of both records (1/32 mV), a record without a range spans only its mean
+    int32_t weMin = no2_we == record_missing ? record_we_min(next) : record_we_min(*this);
+    int32_t weMax = no2_we == record_missing ? record_we_max(next) : record_we_max(*this);
+    if (no2_we != record_missing && next.no2_we != record_missing)
+    {
+        weMin = record_we_min(next) < weMin ? record_we_min(next) : weMin;
+        weMax = record_we_max(next) > weMax ? record_we_max(next) : weMax;
+    }
+
+    no2_ae = record_mean(no2_ae, n, next.no2_ae, m);
+    no2_we = record_mean(no2_we, n, next.no2_we, m);
+    no2_we_below = no2_we == record_missing ? record_range_missing : record_range(no2_we - weMin);
+    no2_we_above = no2_we == record_missing ? record_range_missing : record_range(weMax - no2_we);
+    no2_we_stddev = record_stddev(no2_we_stddev, n, next.no2_we_stddev, m);
+    no2_ae_stddev = record_stddev(no2_ae_stddev, n, next.no2_ae_stddev, m);
+    o3_ppb = record_mean(o3_ppb, n, next.o3_ppb, m);
+    co_ppb = record_mean(co_ppb, n, next.co_ppb, m);
+    no2_ugm3 = record_mean(no2_ugm3, n, next.no2_ugm3, m);
+    no2_ppb = record_mean(no2_ppb, n, next.no2_ppb, m);
+    samples = n + m < UINT16_MAX ? n + m : UINT16_MAX;
+}
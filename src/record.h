@@ -0,0 +1,72 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Compact measurement record for the queue and the log (40 bytes instead of 120 bytes of
+ * EnvironmentData). It holds the values which are sent and logged in fixed-point:
+ *   timestamp     uint32  seconds since 2018-01-01 (payload_timestamp)
+ *   latitude      int32   micro-degrees
+ *   longitude     int32   micro-degrees
+ *   temperature   int16   0.01 °C
+ *   humidity      int16   0.01 %
+ *   pressure      int16   0.1 hPa
+ *   no2_ae        int16   1/32 mV (the resolution of the ADS1115)
+ *   no2_we        int16   1/32 mV
+ *   samples       uint16  number of measurements merged into the record (1 for a single 
+ *                         measurement, see PersistentQueue::downsample)
+ *   no2_we_stddev int16   1/32 mV, noise of the averaging window
+ *   no2_ae_stddev int16   1/32 mV
+ *   o3_ppb        int16   0.1 ppb (O3 sensor board of the sensor array)
+ *   co_ppb        int16   1 ppb (CO sensor board)
+ *   no2_ugm3      int16   0.1 ug/m3, NO2 of the calibration model
+ *   calibration_version uint16 version of the calibration model (0 = none), only records 
+ *                         of the same version are merged
+ *   no2_ppb       int16   0.1 ppb of NO2_ALGORITHM (for the log, the uplink leaves it to 
+ *                         the backend)
+ *   no2_we_below  uint8   0.5 mV, distance of the smallest WE of the merged measurements
+ *                         below no2_we (0 for a single measurement, clamped at 127 mV)
+ *   no2_we_above  uint8   0.5 mV, distance of the largest WE above no2_we
+ * Values which are not available (NaN) are stored as record_missing (record_range_missing
+ * for the WE range), no date as 0xFFFFFFFF and no GPS fix as 0/0 like in EnvironmentData.
+ */
+
+#ifndef _record_h_
+#define _record_h_
+
+#include "measurement.h"
+
+const int16_t record_missing = INT16_MIN;
+const uint8_t record_range_missing = 0xFF;
+
+class MeasurementRecord
+{
+public:
+    uint32_t timestamp;
+    int32_t latitude;
+    int32_t longitude;
+    int16_t temperature;
+    int16_t humidity;
+    int16_t pressure;
+    int16_t no2_ae;
+    int16_t no2_we;
+    uint16_t samples;
+    int16_t no2_we_stddev;
+    int16_t no2_ae_stddev;
+    int16_t o3_ppb;
+    int16_t co_ppb;
+    int16_t no2_ugm3;
+    uint16_t calibration_version;
+    int16_t no2_ppb;
+    uint8_t no2_we_below;
+    uint8_t no2_we_above;
+
+    void pack(EnvironmentData *data);
+    void unpack(EnvironmentData *data);
+    void merge(const MeasurementRecord &next);
+};
+
+static_assert(sizeof(MeasurementRecord) == 40, "MeasurementRecord must stay 40 bytes");
+
+#endif
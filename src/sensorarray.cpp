@@ -0,0 +1,94 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "sensorarray.h"
+
+// ADS1115 registers and config bits (see ADS1115 datasheet)
+const uint8_t ads_reg_conversion = 0x00;
+const uint8_t ads_reg_config = 0x01;
+const uint16_t ads_config_start = 0x8000;    // OS - start a single conversion
+const uint16_t ads_config_mux_0_1 = 0x0000;  // differential P = AIN0, N = AIN1
+const uint16_t ads_config_mux_2_3 = 0x3000;  // differential P = AIN2, N = AIN3
+const uint16_t ads_config_gain_four = 0x0400; // +/-1.024V (0.03125 mV per bit)
+const uint16_t ads_config_single = 0x0100;   // single-shot mode
+const uint16_t ads_config_128sps = 0x0080;   // 128 samples per second
+const uint16_t ads_config_no_comp = 0x0003;  // comparator disabled
+
+GasSensor::GasSensor()
+    : gas(GAS_NO2), address(0x48), calibration(0, 0, 0, 0, 0, 1), algorithm(NULL)
+{
+}
+
+GasSensor::GasSensor(GasType _gas, uint8_t _address, NO2Sensor _calibration, GasAlgorithm _algorithm)
+    : gas(_gas), address(_address), calibration(_calibration), algorithm(_algorithm)
+{
+}
+
+bool SensorArray::add(GasSensor sensor)
+{
+    if (sensorCount >= maxSensors)
+    {
+        return false;
+    }
+    sensors[sensorCount++] = sensor;
+    return true;
+}
+
+int SensorArray::count()
+{
+    return sensorCount;
+}
+
+GasSensor &SensorArray::sensor(int index)
+{
+    return sensors[index];
+}
+
+void SensorArray::startWE(bool *started)
+{
+    for (int i = 0; i < sensorCount; i++)
+    {
+        started[i] = startConversion(sensors[i].address, ads_config_mux_0_1);
+    }
+}
+
+void SensorArray::startAE(bool *started)
+{
+    for (int i = 0; i < sensorCount; i++)
+    {
+        started[i] = startConversion(sensors[i].address, ads_config_mux_2_3);
+    }
+}
+
+void SensorArray::collect(int16_t *values, bool *valid)
+{
+    for (int i = 0; i < sensorCount; i++)
+    {
+        valid[i] = readConversion(sensors[i].address, &values[i]);
+    }
+}
+
+bool SensorArray::startConversion(uint8_t address, uint16_t mux)
+{
+    uint16_t config = ads_config_start | mux | ads_config_gain_four | ads_config_single 
+        | ads_config_128sps | ads_config_no_comp;
+
+    uint8_t data[3] = { ads_reg_config, (uint8_t) (config >> 8), (uint8_t) (config & 0xFF) };
+    return bus.write(address, data, 3) == I2C_OK;
+}
+
+bool SensorArray::readConversion(uint8_t address, int16_t *value)
+{
+    uint8_t reg = ads_reg_conversion;
+    uint8_t buffer[2];
+    if (bus.writeRead(address, &reg, 1, buffer, 2) != I2C_OK)
+    {
+        return false;
+    }
+    *value = (int16_t) ((buffer[0] << 8) | buffer[1]);
+    return true;
+}
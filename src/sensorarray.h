@@ -0,0 +1,66 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _sensorarray_h_
+#define _sensorarray_h_
+
+#include "measurement.h"
+#include "i2cbus.h"
+
+// O3 and CO are reserved for boards with their own algorithm (only NO2 is supported yet)
+enum GasType 
+{
+    GAS_NO2,
+    GAS_O3,
+    GAS_CO
+};
+
+/* 
+ * Conversion of the averaged WE/AE voltages (mV) into ppb for one gas
+ */
+typedef float (*GasAlgorithm)(const NO2Sensor &sensor, float we, float ae, float temperature);
+
+/* 
+ * This class holds one alphasense sensor board of the sensor array. Each board is 
+ * connected to its own ADS1115 (WE on ports 0/1, AE on ports 2/3).
+ */
+class GasSensor
+{
+public:
+    GasType gas;
+    uint8_t address;
+    NO2Sensor calibration;
+    GasAlgorithm algorithm;
+    GasSensor();
+    GasSensor(GasType _gas, uint8_t _address, NO2Sensor _calibration, GasAlgorithm _algorithm);
+};
+
+/* 
+ * This class is the registry of all sensor boards (up to four ADS1115 on the addresses 0x48 - 0x4B).
+ * The conversions are started on all ADS1115 first and collected afterwards, so a scan 
+ * of all boards takes the same time as a single conversion.
+ */
+class SensorArray
+{
+public:
+    static const int maxSensors = 4;
+    static const int conversionDelay = 10; // ms, 128 samples per second (7.8 ms +/-10%)
+    bool add(GasSensor sensor);
+    int count();
+    GasSensor &sensor(int index);
+    void startWE(bool *started);
+    void startAE(bool *started);
+    void collect(int16_t *values, bool *valid);
+private:
+    GasSensor sensors[maxSensors];
+    int sensorCount = 0;
+    I2CClient bus;
+    bool startConversion(uint8_t address, uint16_t mux);
+    bool readConversion(uint8_t address, int16_t *value);
+};
+
+#endif
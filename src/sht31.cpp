@@ -0,0 +1,95 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "sht31.h"
+
+// SHT31 commands (see SHT3x datasheet)
+const uint16_t sht31_cmd_soft_reset = 0x30A2;
+const uint16_t sht31_cmd_heater_on = 0x306D;
+const uint16_t sht31_cmd_heater_off = 0x3066;
+const uint16_t sht31_cmd_periodic_1mps_high = 0x2130; // one measurement per second, high repeatability
+const uint16_t sht31_cmd_fetch = 0xE000;
+const uint16_t sht31_cmd_break = 0x3093;
+const int sht31_reset_delay = 2;   // ms
+const int sht31_command_delay = 1; // ms, minimum time between two commands
+
+bool SHT31Sensor::begin(uint8_t _address)
+{
+    address = _address;
+    bool success = writeCommand(sht31_cmd_soft_reset);
+    delay(sht31_reset_delay);
+    return success;
+}
+
+bool SHT31Sensor::heater(bool on)
+{
+    return writeCommand(on ? sht31_cmd_heater_on : sht31_cmd_heater_off);
+}
+
+bool SHT31Sensor::startPeriodic()
+{
+    return writeCommand(sht31_cmd_periodic_1mps_high);
+}
+
+bool SHT31Sensor::stopPeriodic()
+{
+    return writeCommand(sht31_cmd_break);
+}
+
+bool SHT31Sensor::read(float *temperature, float *humidity)
+{
+    *temperature = NAN;
+    *humidity = NAN;
+
+    // the sensor answers the fetch with a NACK if no new measurement is available
+    uint8_t command[2] = { (uint8_t) (sht31_cmd_fetch >> 8), (uint8_t) (sht31_cmd_fetch & 0xFF) };
+    uint8_t buffer[6];
+    if (bus.writeRead(address, command, 2, buffer, 6) != I2C_OK)
+    {
+        return false;
+    }
+
+    if (crc8(buffer, 2) != buffer[2] || crc8(buffer + 3, 2) != buffer[5])
+    {
+        crcErrorCount++;
+        return false;
+    }
+
+    uint16_t rawTemperature = (buffer[0] << 8) | buffer[1];
+    uint16_t rawHumidity = (buffer[3] << 8) | buffer[4];
+    *temperature = -45.0F + 175.0F * rawTemperature / 65535.0F;
+    *humidity = 100.0F * rawHumidity / 65535.0F;
+    return true;
+}
+
+uint16_t SHT31Sensor::crcErrors()
+{
+    return crcErrorCount;
+}
+
+bool SHT31Sensor::writeCommand(uint16_t command)
+{
+    uint8_t data[2] = { (uint8_t) (command >> 8), (uint8_t) (command & 0xFF) };
+    bool success = bus.write(address, data, 2) == I2C_OK;
+    delay(sht31_command_delay);
+    return success;
+}
+
+uint8_t SHT31Sensor::crc8(const uint8_t *data, int length)
+{
+    // polynomial 0x31 (x^8 + x^5 + x^4 + 1), initialization 0xFF
+    uint8_t crc = 0xFF;
+    for (int i = 0; i < length; i++)
+    {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = (crc & 0x80) ? (crc << 1) ^ 0x31 : (crc << 1);
+        }
+    }
+    return crc;
+}
@@ -0,0 +1,37 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _sht31_h_
+#define _sht31_h_
+
+#include <Arduino.h>
+
+#include "i2cbus.h"
+
+/* 
+ * This class drives the SHT31 in periodic acquisition mode. The sensor converts on its own
+ * (one measurement per second), so a reading is a single fetch of 6 bytes (temperature and 
+ * humidity, each followed by its CRC-8) without any conversion wait on the I2C bus.
+ */
+class SHT31Sensor
+{
+public:
+    bool begin(uint8_t _address);
+    bool heater(bool on);
+    bool startPeriodic();
+    bool stopPeriodic();
+    bool read(float *temperature, float *humidity);
+    uint16_t crcErrors();
+private:
+    uint8_t address = 0x44;
+    uint16_t crcErrorCount = 0;
+    I2CClient bus;
+    bool writeCommand(uint16_t command);
+    static uint8_t crc8(const uint8_t *data, int length);
+};
+
+#endif
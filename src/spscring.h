@@ -0,0 +1,72 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _spscring_h_
+#define _spscring_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+
+/* 
+ * Wait-free ring of "size" items (a power of two) between exactly one producer 
+ * task and one consumer task. The items are written and read in place: the producer 
+ * fills the slot of acquire() and publishes it with commit(), the consumer reads 
+ * the slots of peek() and hands them back with ack(). A slot is owned by one side 
+ * at a time, so no copy through the kernel and no critical section is needed.
+ */
+template <typename T, int size> class SPSCRing
+{
+    static_assert(size > 0 && (size & (size - 1)) == 0, "size must be a power of two");
+
+public:
+    // producer: free slot or NULL if the ring is full
+    T *acquire()
+    {
+        uint32_t h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= (uint32_t) size)
+        {
+            return NULL;
+        }
+        return &slots[h & (size - 1)];
+    }
+
+    // producer: publishes the slot of acquire()
+    void commit()
+    {
+        head.store(head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // consumer: number of published items
+    int count()
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_relaxed);
+    }
+
+    // consumer: item "index" (0 = oldest) or NULL, valid until it is acknowledged
+    T *peek(int index = 0)
+    {
+        if (index < 0 || index >= count())
+        {
+            return NULL;
+        }
+        return &slots[(tail.load(std::memory_order_relaxed) + index) & (size - 1)];
+    }
+
+    // consumer: releases the "items" oldest items to the producer
+    void ack(int items = 1)
+    {
+        tail.store(tail.load(std::memory_order_relaxed) + items, std::memory_order_release);
+    }
+
+private:
+    T slots[size];
+    std::atomic<uint32_t> head { 0 };
+    std::atomic<uint32_t> tail { 0 };
+};
+
+#endif
@@ -0,0 +1,134 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "statistics.h"
+
+#include <algorithm>
+
+void RunningStatistics::reset()
+{
+    n = 0;
+    m = 0;
+    m2 = 0;
+    min_value = 0;
+    max_value = 0;
+    windowIndex = 0;
+}
+
+void RunningStatistics::add(float value)
+{
+    n++;
+    float delta = value - m;
+    m += delta / n;
+    m2 += delta * (value - m);
+
+    if (n == 1 || value < min_value)
+    {
+        min_value = value;
+    }
+    if (n == 1 || value > max_value)
+    {
+        max_value = value;
+    }
+
+    window[windowIndex] = value;
+    windowIndex = (windowIndex + 1) % windowSize;
+}
+
+uint16_t RunningStatistics::count()
+{
+    return n;
+}
+
+float RunningStatistics::mean()
+{
+    return m;
+}
+
+float RunningStatistics::variance()
+{
+    if (n < 2)
+    {
+        return 0;
+    }
+    return m2 / (n - 1);
+}
+
+float RunningStatistics::stddev()
+{
+    return sqrtf(variance());
+}
+
+float RunningStatistics::minimum()
+{
+    return min_value;
+}
+
+float RunningStatistics::maximum()
+{
+    return max_value;
+}
+
+float RunningStatistics::spread()
+{
+    return max_value - min_value;
+}
+
+int RunningStatistics::windowCount()
+{
+    return n < windowSize ? n : windowSize;
+}
+
+float RunningStatistics::median()
+{
+    int count = windowCount();
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    // quickselect on a copy of the window - O(n) on average
+    float values[windowSize];
+    memcpy(values, window, count * sizeof(float));
+    int k = count / 2;
+    std::nth_element(values, values + k, values + count);
+    float upper = values[k];
+    if (count % 2 == 1)
+    {
+        return upper;
+    }
+
+    // even count: the lower middle value is the maximum of the lower half
+    return (*std::max_element(values, values + k) + upper) / 2;
+}
+
+float RunningStatistics::trimmedMean(float trim)
+{
+    int count = windowCount();
+    int cut = (int) (count * trim);
+    if (count == 0 || 2 * cut >= count)
+    {
+        return median();
+    }
+
+    // partition the copy so that the lowest and highest "cut" values are
+    // moved to both ends, then average the remaining values in the middle
+    float values[windowSize];
+    memcpy(values, window, count * sizeof(float));
+    if (cut > 0)
+    {
+        std::nth_element(values, values + cut, values + count);
+        std::nth_element(values + cut, values + count - cut - 1, values + count);
+    }
+
+    float sum = 0;
+    for (int i = cut; i < count - cut; i++)
+    {
+        sum += values[i];
+    }
+    return sum / (count - 2 * cut);
+}
@@ -0,0 +1,44 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _statistics_h_
+#define _statistics_h_
+
+#include <Arduino.h>
+
+/* 
+ * This class accumulates the readings of one averaging window in a single pass.
+ * Mean and variance are calculated with the Welford algorithm. The last readings
+ * are kept in a small fixed window for the median and the trimmed mean.
+ */
+class RunningStatistics
+{
+public:
+    static const int windowSize = 32;
+    void reset();
+    void add(float value);
+    uint16_t count();
+    float mean();
+    float variance();
+    float stddev();
+    float minimum();
+    float maximum();
+    float spread();
+    float median();
+    float trimmedMean(float trim);
+private:
+    uint16_t n = 0;
+    float m = 0;
+    float m2 = 0;
+    float min_value = 0;
+    float max_value = 0;
+    float window[windowSize];
+    int windowIndex = 0;
+    int windowCount();
+};
+
+#endif
@@ -0,0 +1,145 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "textwriter.h"
+
+#include <math.h>
+
+// powers of ten up to the largest supported number of decimals
+static const uint64_t textwriter_pow10[] = { 1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL, 100000000ULL, 1000000000ULL };
+static const int textwriter_decimals_max = 9;
+
+// larger values are written as "inf" (the fixed-point integer must not overflow)
+static const double textwriter_fixed_max = 9e9;
+
+TextWriter::TextWriter(char *_buffer, int _size)
+{
+    buffer = _buffer;
+    size = _size;
+    if (size > 0)
+    {
+        buffer[0] = 0;
+    }
+}
+
+void TextWriter::write(char c)
+{
+    if (position < size - 1)
+    {
+        buffer[position] = c;
+        buffer[position + 1] = 0;
+    }
+    position++;
+}
+
+void TextWriter::write(const char *text)
+{
+    while (*text)
+    {
+        write(*text++);
+    }
+}
+
+void TextWriter::writeInt(int32_t value, int width, char pad)
+{
+    bool negative = value < 0;
+    uint64_t magnitude = negative ? -(int64_t) value : value;
+    writeNumber(negative, false, magnitude, 0, 0, width, pad);
+}
+
+void TextWriter::writeFixed(double value, int decimals, int width, bool plus)
+{
+    if (decimals > textwriter_decimals_max)
+    {
+        decimals = textwriter_decimals_max;
+    }
+    if (isnan(value))
+    {
+        write("nan");
+        return;
+    }
+
+    bool negative = signbit(value);
+    double magnitude = fabs(value);
+    if (magnitude > textwriter_fixed_max)
+    {
+        if (negative)
+        {
+            write('-');
+        }
+        write("inf");
+        return;
+    }
+
+    // one rounding on the scaled value, so 0.9999999 with 6 decimals carries into the integer part;
+    // ties are rounded to even like printf does (floats scaled by 10^6 are exact in a double)
+    double exact = magnitude * textwriter_pow10[decimals];
+    uint64_t scaled = (uint64_t) exact;
+    double remainder = exact - scaled;
+    if (remainder > 0.5 || (remainder == 0.5 && (scaled & 1)))
+    {
+        scaled++;
+    }
+    writeNumber(negative, plus, scaled / textwriter_pow10[decimals], scaled % textwriter_pow10[decimals], decimals, width, '0');
+}
+
+void TextWriter::writeNumber(bool negative, bool plus, uint64_t integer, uint64_t fraction, int decimals, int width, char pad)
+{
+    // digits of the integer part in reverse order
+    char digits[20];
+    int count = 0;
+    do
+    {
+        digits[count++] = '0' + integer % 10;
+        integer /= 10;
+    } while (integer > 0);
+
+    bool sign = negative || plus;
+    int textLength = sign + count + (decimals > 0 ? decimals + 1 : 0);
+
+    if (pad == ' ')
+    {
+        for (int i = textLength; i < width; i++)
+        {
+            write(' ');
+        }
+    }
+    if (sign)
+    {
+        write(negative ? '-' : '+');
+    }
+    if (pad != ' ')
+    {
+        for (int i = textLength; i < width; i++)
+        {
+            write('0');
+        }
+    }
+    while (count > 0)
+    {
+        write(digits[--count]);
+    }
+
+    if (decimals > 0)
+    {
+        write('.');
+        for (int i = decimals - 1; i >= 0; i--)
+        {
+            write('0' + (fraction / textwriter_pow10[i]) % 10);
+        }
+    }
+}
+
+int TextWriter::length()
+{
+    return position;
+}
+
+bool TextWriter::overflow()
+{
+    return position >= size;
+}
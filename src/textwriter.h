@@ -0,0 +1,39 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#ifndef _textwriter_h_
+#define _textwriter_h_
+
+#include <stdint.h>
+
+/* 
+ * Writes numbers as decimal text into a bounded char buffer without sprintf.
+ * Floats are rounded to fixed-point integers and written digit by digit, so
+ * neither the float printf of newlib nor its reentrancy lock is needed.
+ * The text is always terminated; characters beyond the buffer are dropped
+ * but counted, so the caller can detect the overflow.
+ */
+class TextWriter
+{
+public:
+    TextWriter(char *_buffer, int _size);
+    void write(char c);
+    void write(const char *text);
+    // like printf %0<width>d (pad = '0') or %<width>d (pad = ' ')
+    void writeInt(int32_t value, int width = 0, char pad = '0');
+    // like printf %0<width>.<decimals>f, with plus = true like %+0<width>.<decimals>f
+    void writeFixed(double value, int decimals, int width = 0, bool plus = false);
+    int length();
+    bool overflow();
+private:
+    char *buffer;
+    int size;
+    int position = 0;
+    void writeNumber(bool negative, bool plus, uint64_t integer, uint64_t fraction, int decimals, int width, char pad);
+};
+
+#endif
@@ -0,0 +1,81 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ */
+
+#include "uplink.h"
+#include "payload.h"
+
+/* 
+ * Shape with the least airtime per record for the field bitmap "fields"
+ * (ties are won by the shape with more records)
+ */
+static UplinkPlan uplink_best(EnvironmentData *records, int count, uint8_t *buffer, int size, uint16_t fields)
+{
+    UplinkPlan best;
+    best.fields = fields;
+
+    // a single record is sent bit-packed if this is shorter than the compressed batch
+    int length = count > 0 ? records[0].lora_payload(buffer) : 0;
+    if (fields == payload_fields_all && length > 0 && length <= size)
+    {
+        best.port = payload_port;
+        best.records = 1;
+        best.length = length;
+        best.airtime = LMIC_airTime(length);
+    }
+
+    for (int n = 1; n <= count && n <= payload_batch_max; n++)
+    {
+        if (payload_encode_compressed(records, n, buffer, size, &length, fields) < n)
+        {
+            break;
+        }
+        ostime_t airtime = LMIC_airTime(length);
+        int64_t cost = (int64_t) airtime * best.records;
+        int64_t bestCost = (int64_t) best.airtime * n;
+        if (best.records == 0 || cost < bestCost || (cost == bestCost && n > best.records))
+        {
+            best.port = payload_compressed_port;
+            best.records = n;
+            best.length = length;
+            best.airtime = airtime;
+        }
+    }
+
+    best.offTime = best.airtime * LMIC_txCap();
+    return best;
+}
+
+/* 
+ * Encodes the next uplink into the buffer (payload_batch_size_max bytes),
+ * measurementInterval is the time between two measurements in ms
+ */
+UplinkPlan uplink_compose(EnvironmentData *records, int count, uint8_t *buffer, uint32_t measurementInterval)
+{
+    int size = LMIC_maxPayloadLen();
+    UplinkPlan plan = uplink_best(records, count, buffer, size, payload_fields_all);
+
+    // the backlog grows if a frame blocks the band longer than its records take to be measured
+    bool backlog = plan.records < count;
+    if (backlog && plan.offTime > (int64_t) ms2osticks(measurementInterval) * plan.records)
+    {
+        UplinkPlan essential = uplink_best(records, count, buffer, size, payload_fields_essential);
+        if ((int64_t) essential.airtime * plan.records < (int64_t) plan.airtime * essential.records)
+        {
+            plan = essential;
+        }
+    }
+
+    if (plan.port == payload_port)
+    {
+        records[0].lora_payload(buffer);
+    }
+    else if (plan.records > 0)
+    {
+        payload_encode_compressed(records, plan.records, buffer, size, &plan.length, plan.fields);
+    }
+    return plan;
+}
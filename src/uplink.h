@@ -0,0 +1,35 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Chooses the shape of the next uplink from the current datarate and duty cycle:
+ * the format (single payload or compressed batch, see payload.h), the number of
+ * records per frame and the sent fields. The shape with the least airtime per
+ * record (calcAirTime of LMIC) is taken. If the node cannot keep up with the
+ * measurements at a slow datarate (the duty cycle off time of a frame is longer
+ * than the time in which its records are measured), the position is dropped.
+ */
+
+#ifndef _uplink_h_
+#define _uplink_h_
+
+#include <lmic.h>
+
+#include "measurement.h"
+
+class UplinkPlan
+{
+public:
+    uint8_t port = 0;
+    uint16_t fields = 0;
+    int records = 0;
+    int length = 0;
+    ostime_t airtime = 0;
+    ostime_t offTime = 0;
+};
+
+UplinkPlan uplink_compose(EnvironmentData *records, int count, uint8_t *buffer, uint32_t measurementInterval);
+
+#endif
@@ -0,0 +1,108 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host benchmark of the altitude table of the BMP180 task (BMP180Sensor::pressureToAltitude)
+ * against the barometric formula with powf. It prints the largest difference of both for
+ * random pressures and the time per conversion. The table and the interpolation are the
+ * ones of bmp180.cpp (which needs the I2C bus and cannot be built on the host).
+ *
+ *   g++ -O2 tools/altitude_benchmark.cpp -o altitude_benchmark
+ *   ./altitude_benchmark
+ */
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+const float sea_level_pressure = 1013.25F; // hPa
+
+const int altitude_table_size = 65;
+const float altitude_table_min = 0.3F;
+const float altitude_table_step = 0.0125F;
+static float altitude_table[altitude_table_size];
+
+static float altitude_powf(float p)
+{
+    return 44330.0F * (1.0F - powf(p / sea_level_pressure, 1.0F / 5.255F));
+}
+
+static float altitude_interpolated(float p)
+{
+    float x = (p / sea_level_pressure - altitude_table_min) * (1.0F / altitude_table_step);
+    if (!(x > 0))
+    {
+        return 44330.0F * (1.0F - altitude_table[0]);
+    }
+    if (x >= altitude_table_size - 1)
+    {
+        return 44330.0F * (1.0F - altitude_table[altitude_table_size - 1]);
+    }
+    int i = (int) x;
+    float f = x - i;
+    return 44330.0F * (1.0F - (altitude_table[i] + f * (altitude_table[i + 1] - altitude_table[i])));
+}
+
+static float uniform(float minimum, float maximum)
+{
+    return minimum + (maximum - minimum) * rand() / RAND_MAX;
+}
+
+typedef float (*Conversion)(float);
+
+static volatile float sink;
+
+static double nanoseconds(Conversion conversion, const float *pressures, int count, int rounds)
+{
+    float sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            sum += conversion(pressures[i]);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    sink = sum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double) count * rounds);
+}
+
+int main()
+{
+    const int count = 1000;
+    const int rounds = 2000;
+    static float pressures[count];
+
+    for (int i = 0; i < altitude_table_size; i++)
+    {
+        altitude_table[i] = powf(altitude_table_min + i * altitude_table_step, 1.0F / 5.255F);
+    }
+
+    // the range of the table and the range of the recorded measurements (data/*.csv)
+    float difference = 0;
+    float differenceRecorded = 0;
+    for (int step = 31000; step <= 111000; step++)
+    {
+        float p = step * 0.01F;
+        float d = fabsf(altitude_interpolated(p) - altitude_powf(p));
+        difference = d > difference ? d : difference;
+        if (p >= 900 && p <= 1050)
+        {
+            differenceRecorded = d > differenceRecorded ? d : differenceRecorded;
+        }
+    }
+    printf("max difference: %.2f m (310 - 1110 hPa), %.2f m (900 - 1050 hPa)\n", difference, differenceRecorded);
+
+    for (int i = 0; i < count; i++)
+    {
+        pressures[i] = uniform(900, 1050);
+    }
+    double formula = nanoseconds(altitude_powf, pressures, count, rounds);
+    double table = nanoseconds(altitude_interpolated, pressures, count, rounds);
+    printf("altitude  powf %6.2f ns  table %6.2f ns  speedup %.1fx\n", formula, table, formula / table);
+    return difference < 1.5F ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host benchmark of the TextWriter messages of src/message.cpp against sprintf for the 
+ * CSV line of the data logger (EnvironmentData::logger_message) and the ascii LoRa 
+ * message. It checks that both produce the same text for random measurements and prints 
+ * the time per message.
+ *
+ *   g++ -O2 -std=c++11 -Itools/host -Isrc tools/format_benchmark.cpp src/message.cpp src/textwriter.cpp -o format_benchmark
+ *   ./format_benchmark
+ */
+
+#include "measurement.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+static int logger_sprintf(EnvironmentData &d, char *out, int size)
+{
+    return snprintf(out, size, "%4d-%02d-%02d,%02d:%02d:%02d,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%f,%d,%d,%f,%f\n",
+        d.gps_year, d.gps_month, d.gps_day, d.gps_hour, d.gps_minute, d.gps_second, d.gps_latitude, d.gps_longitude,
+        d.sht31_temperature, d.sht31_humidity, d.bmp180_pressure, d.no2_ae, d.no2_we, d.no2_ppb,
+        d.no2_we_stddev, d.no2_ae_stddev, d.o3_ppb, d.co_ppb, d.no2_ugm3, d.calibration_version, d.samples,
+        d.no2_we_min, d.no2_we_max);
+}
+
+static int logger_textwriter(EnvironmentData &d, char *out, int size)
+{
+    return d.logger_message(out, size);
+}
+
+static int lora_sprintf(EnvironmentData &d, char *out, int size)
+{
+    return snprintf(out, size, "%+03.0f%02.0f%04.0f%02d%02d%02d%02d%02d%02d%06.0f%06.0f%06.0f%06.0f",
+        d.sht31_temperature, d.sht31_humidity, d.bmp180_pressure, d.gps_year - 2000, d.gps_month, d.gps_day, 
+        d.gps_hour, d.gps_minute, d.gps_second, d.gps_latitude * 10000, d.gps_longitude * 10000, 
+        d.no2_ae * 1000, d.no2_we * 1000);
+}
+
+static int lora_textwriter(EnvironmentData &d, char *out, int size)
+{
+    return d.lora_message(out, size);
+}
+
+static double uniform(double minimum, double maximum)
+{
+    return minimum + (maximum - minimum) * rand() / RAND_MAX;
+}
+
+// a value which is missing in about every fourth measurement (no O3/CO board, no calibration)
+static float sometimes(double minimum, double maximum)
+{
+    return rand() % 4 == 0 ? NAN : uniform(minimum, maximum);
+}
+
+typedef int (*Formatter)(EnvironmentData &, char *, int);
+
+static double nanoseconds(Formatter formatter, EnvironmentData *samples, int count, int rounds)
+{
+    char out[300];
+    volatile int sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            sink += formatter(samples[i], out, sizeof(out));
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double) count * rounds);
+}
+
+int main()
+{
+    const int count = 1000;
+    const int rounds = 200;
+    static EnvironmentData samples[count];
+
+    for (int i = 0; i < count; i++)
+    {
+        EnvironmentData &d = samples[i];
+        d.gps_year = 2018;
+        d.gps_month = 1 + rand() % 12;
+        d.gps_day = 1 + rand() % 28;
+        d.gps_hour = rand() % 24;
+        d.gps_minute = rand() % 60;
+        d.gps_second = rand() % 60;
+        d.gps_latitude = uniform(47, 49);
+        d.gps_longitude = uniform(10, 13);
+        d.sht31_temperature = uniform(-20, 40);
+        d.sht31_humidity = uniform(0, 100);
+        d.bmp180_pressure = uniform(900, 1050);
+        d.no2_ae = uniform(200, 300);
+        d.no2_we = uniform(200, 300);
+        d.no2_ppb = uniform(-50, 150);
+        d.no2_we_stddev = uniform(0, 5);
+        d.no2_ae_stddev = uniform(0, 5);
+        d.o3_ppb = sometimes(0, 200);
+        d.co_ppb = sometimes(0, 2000);
+        d.no2_ugm3 = sometimes(0, 150);
+        d.calibration_version = isnan(d.no2_ugm3) ? 0 : 1 + rand() % 10;
+        d.samples = rand() % 2 == 0 ? 1 : 1 + rand() % 1022;
+        d.no2_we_min = d.samples > 1 ? d.no2_we - uniform(0, 10) : NAN;
+        d.no2_we_max = d.samples > 1 ? d.no2_we + uniform(0, 10) : NAN;
+    }
+
+    int differences = 0;
+    for (int i = 0; i < count; i++)
+    {
+        char a[300], b[300];
+        logger_sprintf(samples[i], a, sizeof(a));
+        logger_textwriter(samples[i], b, sizeof(b));
+        differences += strcmp(a, b) != 0;
+        lora_sprintf(samples[i], a, sizeof(a));
+        lora_textwriter(samples[i], b, sizeof(b));
+        differences += strcmp(a, b) != 0;
+    }
+    printf("messages with different text: %d of %d\n", differences, 2 * count);
+
+    double loggerPrintf = nanoseconds(logger_sprintf, samples, count, rounds);
+    double loggerText = nanoseconds(logger_textwriter, samples, count, rounds);
+    double loraPrintf = nanoseconds(lora_sprintf, samples, count, rounds);
+    double loraText = nanoseconds(lora_textwriter, samples, count, rounds);
+    printf("logger_message  sprintf %7.0f ns  TextWriter %7.0f ns  speedup %.1fx\n", loggerPrintf, loggerText, loggerPrintf / loggerText);
+    printf("lora_message    sprintf %7.0f ns  TextWriter %7.0f ns  speedup %.1fx\n", loraPrintf, loraText, loraPrintf / loraText);
+    return differences == 0 ? 0 : 1;
+}
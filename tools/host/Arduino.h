@@ -0,0 +1,69 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Minimal stand-in for Arduino.h, so the payload and message code builds on the
+ * host for the benchmarks in tools/ (and the queue and the log for the host checks)
+ */
+
+#ifndef _host_arduino_h_
+#define _host_arduino_h_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <math.h>
+
+typedef void *QueueHandle_t;
+
+// used by TinyGPS++ in tools/nmea_benchmark.cpp and by the data logger
+unsigned long millis();
+unsigned long micros();
+
+/* 
+ * Serial prints to "out" (NULL = nothing is printed), the host checks collect the csv
+ * of the data logger with it. The program which uses it defines the instance.
+ */
+class HostSerial
+{
+public:
+    FILE *out = stdout;
+    int printf(const char *format, ...)
+    {
+        va_list arguments;
+        va_start(arguments, format);
+        int length = out ? vfprintf(out, format, arguments) : 0;
+        va_end(arguments);
+        return length;
+    }
+    void print(const char *text)
+    {
+        if (out)
+        {
+            fputs(text, out);
+        }
+    }
+    void println(const char *text)
+    {
+        if (out)
+        {
+            fputs(text, out);
+            fputc('\n', out);
+        }
+    }
+};
+
+extern HostSerial Serial;
+
+#define PI 3.1415926535897932384626433832795
+#define TWO_PI 6.283185307179586476925286766559
+#define radians(deg) ((deg) * (PI / 180.0))
+#define degrees(rad) ((rad) * (180.0 / PI))
+#define sq(x) ((x) * (x))
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * File of the arduino-esp32 file systems for the host checks: the files are strings in
+ * hostFiles (path -> content), which the program that uses it defines, so a check can
+ * tear or remove a file between two starts of the data logger.
+ */
+
+#ifndef _host_fs_h_
+#define _host_fs_h_
+
+#include <stdint.h>
+#include <string.h>
+#include <map>
+#include <string>
+
+#define FILE_READ "r"
+#define FILE_WRITE "w"
+#define FILE_APPEND "a"
+
+extern std::map<std::string, std::string> hostFiles;
+
+class File
+{
+public:
+    File() {}
+    File(const char *_path, bool directory) : filePath(_path), open(true), isDirectory(directory), next(hostFiles.begin()) {}
+    explicit operator bool() const { return open; }
+    const char *path() { return filePath.c_str(); }
+    const char *name() { return strrchr(filePath.c_str(), '/') + 1; }
+    size_t size() { return hostFiles[filePath].size(); }
+    int available() { return position < size(); }
+    size_t write(const uint8_t *data, size_t length)
+    {
+        hostFiles[filePath].append((const char *) data, length);
+        return length;
+    }
+    bool seek(uint32_t offset)
+    {
+        if (offset > size())
+        {
+            return false;
+        }
+        position = offset;
+        return true;
+    }
+    size_t read(uint8_t *buffer, size_t length)
+    {
+        size_t n = length < size() - position ? length : size() - position;
+        memcpy(buffer, hostFiles[filePath].data() + position, n);
+        position += n;
+        return n;
+    }
+    int read()
+    {
+        return position < size() ? (uint8_t) hostFiles[filePath][position++] : -1;
+    }
+    File openNextFile()
+    {
+        // SPIFFS has no directories, "/" lists all files
+        if (!isDirectory || next == hostFiles.end())
+        {
+            return File();
+        }
+        return File((next++)->first.c_str(), false);
+    }
+    void close() {}
+private:
+    std::string filePath;
+    bool open = false;
+    bool isDirectory = false;
+    size_t position = 0;
+    std::map<std::string, std::string>::iterator next;
+};
+
+#endif
@@ -0,0 +1,57 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * SPIFFS on the files of FS.h for the host checks (totalBytes is the size of the 
+ * partition of the check, the program which uses it defines the instance)
+ */
+
+#ifndef _host_spiffs_h_
+#define _host_spiffs_h_
+
+#include "FS.h"
+
+class HostSPIFFS
+{
+public:
+    size_t total = 1024 * 1024;
+    bool begin() { return true; }
+    bool exists(const char *path) { return hostFiles.count(path) > 0; }
+    bool remove(const char *path) { return hostFiles.erase(path) > 0; }
+    File open(const char *path, const char *mode = FILE_READ)
+    {
+        if (strcmp(path, "/") == 0)
+        {
+            return File(path, true);
+        }
+        if (strcmp(mode, FILE_WRITE) == 0)
+        {
+            hostFiles[path] = "";
+        }
+        else if (strcmp(mode, FILE_APPEND) == 0)
+        {
+            hostFiles[path];
+        }
+        else if (!exists(path))
+        {
+            return File();
+        }
+        return File(path, false);
+    }
+    size_t usedBytes()
+    {
+        size_t used = 0;
+        for (auto &file : hostFiles)
+        {
+            used += file.second.size();
+        }
+        return used;
+    }
+    size_t totalBytes() { return total; }
+};
+
+extern HostSPIFFS SPIFFS;
+
+#endif
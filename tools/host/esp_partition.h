@@ -0,0 +1,41 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Partition API of the ESP-IDF for the host checks, the flash is simulated by the
+ * program which uses it (see tools/queue_check.cpp)
+ */
+
+#ifndef _host_esp_partition_h_
+#define _host_esp_partition_h_
+
+#include <stdint.h>
+#include <stddef.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef enum
+{
+    ESP_PARTITION_TYPE_APP = 0x00,
+    ESP_PARTITION_TYPE_DATA = 0x01
+} esp_partition_type_t;
+
+#define ESP_PARTITION_SUBTYPE_ANY 0xff
+
+typedef struct
+{
+    uint32_t address;
+    uint32_t size;
+    const char *label;
+} esp_partition_t;
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, int subtype, const char *label);
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t offset, void *data, size_t length);
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t offset, const void *data, size_t length);
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t length);
+
+#endif
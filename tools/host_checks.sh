@@ -0,0 +1,21 @@
+#!/bin/sh
+#
+# Builds the host checks of the persistent queue and the data logger (simulated flash
+# partition and in-memory SPIFFS, see tools/host) and runs them
+#
+
+set -e
+cd "$(dirname "$0")/.."
+
+BUILD=${BUILD:-.pio/host_checks}
+mkdir -p "$BUILD"
+
+g++ -O2 -std=c++11 -Wall -Itools/host -Isrc \
+    tools/queue_check.cpp src/persistentqueue.cpp src/record.cpp src/payload.cpp \
+    -o "$BUILD/queue_check"
+g++ -O2 -std=c++11 -Wall -Itools/host -Isrc \
+    tools/logger_check.cpp src/datalogger.cpp src/record.cpp src/payload.cpp src/message.cpp src/textwriter.cpp \
+    -o "$BUILD/logger_check"
+
+"$BUILD/queue_check"
+"$BUILD/logger_check"
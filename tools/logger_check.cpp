@@ -0,0 +1,284 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host check of the data logger (src/datalogger.cpp) on the in-memory SPIFFS of
+ * tools/host, the files are torn and removed between two starts like by a power loss:
+ *   torn      a torn record at the end of the segment and a damaged record in the
+ *             middle are skipped, the following records stay readable at their numbers
+ *   range     readRange prints the same records as a scan of all segment files, with
+ *             records which are logged again after a downsampling (back in time),
+ *             restarts which lose the buffered records, a removed and a torn index and
+ *             the rotation and removal of segments
+ *   count     recordCount after a segment which was closed early (log version change)
+ *
+ *   sh tools/host_checks.sh
+ */
+
+#include "datalogger.h"
+#include "SPIFFS.h"
+
+#include <rom/crc.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstddef>
+#include <vector>
+
+std::map<std::string, std::string> hostFiles;
+HostSPIFFS SPIFFS;
+HostSerial Serial;
+
+unsigned long millis()
+{
+    return 0;
+}
+
+unsigned long micros()
+{
+    return 0;
+}
+
+static MeasurementRecord measurement(uint32_t timestamp)
+{
+    MeasurementRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = timestamp;
+    record.temperature = timestamp % 1000;
+    record.humidity = record_missing;
+    record.samples = 1;
+    return record;
+}
+
+// timestamps of the readable records of all segment files of the current log version
+static std::vector<uint32_t> scan_log()
+{
+    std::vector<uint32_t> timestamps;
+    for (auto &file : hostFiles)
+    {
+        const std::string &data = file.second;
+        LogHeader header;
+        if (file.first.compare(file.first.size() - 4, 4, ".bin") != 0 || data.size() < sizeof(header))
+        {
+            continue;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != log_magic || header.version != log_version)
+        {
+            continue;
+        }
+        for (size_t offset = sizeof(header); offset + sizeof(LogRecord) <= data.size(); offset += sizeof(LogRecord))
+        {
+            LogRecord record;
+            memcpy(&record, data.data() + offset, sizeof(record));
+            if (record.crc == crc32_le(0, (const uint8_t *) &record, offsetof(LogRecord, crc)))
+            {
+                timestamps.push_back(record.record.timestamp);
+            }
+        }
+    }
+    return timestamps;
+}
+
+// records of all segment files of the current log version (damaged ones included)
+static uint32_t count_log()
+{
+    uint32_t count = 0;
+    for (auto &file : hostFiles)
+    {
+        const std::string &data = file.second;
+        LogHeader header;
+        if (file.first.compare(file.first.size() - 4, 4, ".bin") != 0 || data.size() < sizeof(header))
+        {
+            continue;
+        }
+        memcpy(&header, data.data(), sizeof(header));
+        if (header.magic == log_magic && header.version == log_version)
+        {
+            count += (data.size() - sizeof(header)) / sizeof(LogRecord);
+        }
+    }
+    return count;
+}
+
+// number of records printed by readRange (the line of the summary)
+static uint32_t read_range(DataLogger &logger, uint32_t from, uint32_t to)
+{
+    FILE *out = tmpfile();
+    Serial.out = out;
+    logger.readRange(from, to);
+    Serial.out = NULL;
+    rewind(out);
+    char line[256];
+    unsigned exported = 0;
+    while (fgets(line, sizeof(line), out))
+    {
+        sscanf(line, "(S) - SPIFFS exported %u records", &exported);
+    }
+    fclose(out);
+    return exported;
+}
+
+static bool check_torn()
+{
+    hostFiles.clear();
+    DataLogger logger("/log", 768 * 1024);
+    logger.init();
+    for (uint32_t i = 0; i < 100; i++)
+    {
+        MeasurementRecord record = measurement(1000 + i);
+        logger.append(&record);
+    }
+
+    // a power loss in the write of record 99 and a bit error in record 10
+    std::string &segment = hostFiles["/log/000000.bin"];
+    segment.resize(segment.size() - 20);
+    segment[sizeof(LogHeader) + 10 * sizeof(LogRecord) + 4] ^= 1;
+
+    DataLogger restarted("/log", 768 * 1024);
+    restarted.init();
+    for (uint32_t i = 100; i < 150; i++)
+    {
+        MeasurementRecord record = measurement(1000 + i);
+        restarted.append(&record);
+    }
+
+    int wrong = 0;
+    for (uint32_t i = 0; i < 150; i++)
+    {
+        LogRecord record;
+        bool readable = restarted.readRecord(i, &record);
+        if (i == 10 || i == 99)
+        {
+            wrong += readable;
+        }
+        else
+        {
+            wrong += !readable || record.record.timestamp != 1000 + i;
+        }
+    }
+    printf("torn: %u records, %d wrong\n", restarted.recordCount(), wrong);
+    return wrong == 0 && restarted.recordCount() == 150;
+}
+
+static bool check_range()
+{
+    hostFiles.clear();
+    srand(1);
+    const size_t budget = 4 * DataLogger::segmentBytes;
+    DataLogger *logger = new DataLogger("/log", budget, 16);
+    logger->init();
+
+    uint32_t time = 100000;
+    int restarts = 0;
+    for (int i = 0; i < 6000; i++)
+    {
+        MeasurementRecord record = measurement(time);
+        logger->append(&record);
+        time += 600;
+
+        if (rand() % 300 == 0)
+        {
+            // the merged records of a downsampling are logged again, they go back in time
+            uint32_t back = time - (rand() % 200 + 20) * 600;
+            for (int j = 0; j < 20; j++)
+            {
+                record = measurement(back + j * 1200);
+                logger->append(&record);
+            }
+        }
+        if (rand() % 700 == 0)
+        {
+            // reset: the buffered records are lost, sometimes with the index of the last segment
+            int pending = logger->pending();
+            delete logger;
+            std::string index;
+            for (auto &file : hostFiles)
+            {
+                index = file.first.compare(file.first.size() - 4, 4, ".idx") == 0 ? file.first : index;
+            }
+            if (!index.empty() && restarts % 3 == 1)
+            {
+                hostFiles.erase(index);
+            }
+            else if (!index.empty() && restarts % 3 == 2 && hostFiles[index].size() > 5)
+            {
+                hostFiles[index].resize(hostFiles[index].size() - 5);
+            }
+            restarts++;
+            logger = new DataLogger("/log", budget, 16);
+            logger->init();
+            // the queue logs its unlogged records again
+            for (int j = pending; j > 0; j--)
+            {
+                record = measurement(time - j * 600);
+                logger->append(&record);
+            }
+        }
+    }
+    logger->flush();
+
+    std::vector<uint32_t> timestamps = scan_log();
+    uint32_t first = *std::min_element(timestamps.begin(), timestamps.end());
+    int wrong = 0;
+    for (int query = 0; query < 300; query++)
+    {
+        uint32_t from = first + rand() % (time - first);
+        uint32_t to = query % 10 == 0 ? 0xFFFFFFFF : from + rand() % 50000;
+        uint32_t expected = 0;
+        for (size_t i = 0; i < timestamps.size(); i++)
+        {
+            expected += timestamps[i] >= from && timestamps[i] <= to;
+        }
+        uint32_t exported = read_range(*logger, from, to);
+        if (exported != expected)
+        {
+            printf("range: %u records from %u to %u, %u expected\n", exported, from, to, expected);
+            wrong++;
+        }
+    }
+    bool counted = logger->recordCount() == count_log();
+    printf("range: %zu records, %d restarts, 300 ranges, %d wrong, record count %u of %u\n",
+        timestamps.size(), restarts, wrong, logger->recordCount(), count_log());
+    delete logger;
+    return wrong == 0 && counted;
+}
+
+static bool check_count()
+{
+    hostFiles.clear();
+
+    // a full segment of the previous log version is closed by the first start
+    LogHeader header;
+    memset(&header, 0xFF, sizeof(header));
+    header.magic = log_magic;
+    header.version = log_version - 1;
+    header.recordSize = sizeof(LogRecord);
+    header.crc = crc32_le(0, (const uint8_t *) &header, offsetof(LogHeader, crc));
+    hostFiles["/log/000000.bin"] = std::string((const char *) &header, sizeof(header))
+        + std::string(DataLogger::segmentRecords * sizeof(LogRecord), 0);
+
+    DataLogger logger("/log", 768 * 1024);
+    logger.init();
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        MeasurementRecord record = measurement(1000 + i);
+        logger.append(&record);
+    }
+    DataLogger restarted("/log", 768 * 1024);
+    restarted.init();
+    printf("count: %u and %u records after the version change, 10 expected\n", logger.recordCount(), restarted.recordCount());
+    return logger.recordCount() == 10 && restarted.recordCount() == 10;
+}
+
+int main()
+{
+    Serial.out = NULL;
+    bool success = check_torn();
+    success = check_range() && success;
+    success = check_count() && success;
+    printf("%s\n", success ? "logger checks passed" : "logger checks FAILED");
+    return success ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host throughput benchmark of the NMEA parser (src/nmea.h). It feeds the output of a
+ * NEO-6M (RMC, GGA, GSA and GSV sentences each second) with moving positions character
+ * by character into the parser, checks every fix against the generated values and
+ * prints the time per character.
+ *
+ *   g++ -O2 -std=c++11 -Itools/host -Isrc tools/nmea_benchmark.cpp src/nmea.cpp -o nmea_benchmark
+ *   ./nmea_benchmark
+ *
+ * TinyGPS++ (the parser which was used before) is not part of the repository. With its
+ * sources (https://github.com/mikalhart/TinyGPSPlus) it is measured on the same
+ * sentences (tools/host/Arduino.h has the few Arduino functions it needs):
+ *
+ *   g++ -O2 -std=c++11 -DARDUINO=100 -DNMEA_TINYGPSPLUS -Itools/host -Isrc -I<TinyGPSPlus>/src \
+ *       tools/nmea_benchmark.cpp src/nmea.cpp <TinyGPSPlus>/src/TinyGPS++.cpp -o nmea_benchmark
+ */
+
+#include "nmea.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#ifdef NMEA_TINYGPSPLUS
+#include <TinyGPS++.h>
+
+unsigned long millis()
+{
+    return 0;
+}
+#endif
+
+struct Expected
+{
+    int hour, minute, second;
+    int32_t latitude, longitude;  // micro degrees
+};
+
+static void add_sentence(std::string &stream, const char *body)
+{
+    uint8_t checksum = 0;
+    for (const char *c = body; *c; c++)
+    {
+        checksum ^= *c;
+    }
+    char line[128];
+    snprintf(line, sizeof(line), "$%s*%02X\r\n", body, checksum);
+    stream += line;
+}
+
+// degrees and minutes with 5 decimals like the NEO-6M
+static void nmea_coordinate(char *out, int size, int32_t micro, int degreeDigits)
+{
+    int32_t value = micro < 0 ? -micro : micro;
+    int degrees = value / 1000000;
+    int32_t minutes = value % 1000000 * 6;   // 1/100000 minutes
+    snprintf(out, size, "%0*d%02d.%05d", degreeDigits, degrees, (int) (minutes / 100000), (int) (minutes % 100000));
+}
+
+/*
+ * One second of the receiver: RMC, GGA, GSA and three GSV sentences
+ */
+static void add_second(std::string &stream, std::vector<Expected> &expected, int index)
+{
+    Expected e;
+    int seconds = index % 86400;
+    e.hour = seconds / 3600;
+    e.minute = seconds / 60 % 60;
+    e.second = seconds % 60;
+    // a micro degree is 6/100000 minutes, so the text is exact
+    e.latitude = 48150000 + (index % 5000) * 3;
+    e.longitude = 11540000 - (index % 7000) * 7;
+    expected.push_back(e);
+
+    char latitude[16], longitude[16], body[128];
+    nmea_coordinate(latitude, sizeof(latitude), e.latitude, 2);
+    nmea_coordinate(longitude, sizeof(longitude), e.longitude, 3);
+
+    snprintf(body, sizeof(body), "GPRMC,%02d%02d%02d.00,A,%s,N,%s,E,0.%03d,,160118,,,A",
+        e.hour, e.minute, e.second, latitude, longitude, index % 1000);
+    add_sentence(stream, body);
+    snprintf(body, sizeof(body), "GPGGA,%02d%02d%02d.00,%s,N,%s,E,1,08,1.01,5%02d.3,M,46.9,M,,",
+        e.hour, e.minute, e.second, latitude, longitude, index % 100);
+    add_sentence(stream, body);
+    add_sentence(stream, "GPGSA,A,3,02,05,12,13,15,20,24,29,,,,,1.92,1.01,1.63");
+    add_sentence(stream, "GPGSV,3,1,11,02,32,141,36,05,45,076,40,12,28,286,31,13,44,224,38");
+    add_sentence(stream, "GPGSV,3,2,11,15,71,174,42,20,14,301,25,24,21,043,33,29,09,107,22");
+    add_sentence(stream, "GPGSV,3,3,11,30,03,257,,40,24,138,,49,32,175,");
+}
+
+int main()
+{
+    const int seconds = 20000;
+    const int rounds = 20;
+    std::string stream;
+    std::vector<Expected> expected;
+    for (int i = 0; i < seconds; i++)
+    {
+        add_second(stream, expected, i);
+    }
+
+    // the fixes of one pass are checked against the generated values (the position of
+    // the fix is exact to the micro degree, RMC and GGA give one fix each)
+    NMEAParser parser;
+    GPSFix fix;
+    int fixes = 0;
+    int errors = 0;
+    for (char c : stream)
+    {
+        if (parser.encode(c, &fix))
+        {
+            const Expected &e = expected[fixes / 2];
+            long dLatitude = labs((long) fix.latitude - e.latitude);
+            long dLongitude = labs((long) fix.longitude - e.longitude);
+            errors += fix.hour != e.hour || fix.minute != e.minute || fix.second != e.second
+                || dLatitude > 1 || dLongitude > 1;
+            fixes++;
+        }
+    }
+    printf("%d sentences, %d fixes, %d wrong fixes, %u checksum errors\n",
+        (int) parser.sentences(), fixes, errors, parser.checksumErrors());
+
+    volatile int32_t sink = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        NMEAParser p;
+        for (char c : stream)
+        {
+            p.encode(c, &fix);
+        }
+        sink = sink + fix.latitude;
+    }
+    auto end = std::chrono::steady_clock::now();
+    double nmea = std::chrono::duration<double, std::nano>(end - start).count() / ((double) stream.size() * rounds);
+    printf("NMEAParser  %6.2f ns/char  %7.1f MB/s\n", nmea, 1000 / nmea);
+
+#ifdef NMEA_TINYGPSPLUS
+    start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        TinyGPSPlus gps;
+        for (char c : stream)
+        {
+            gps.encode(c);
+        }
+        sink = sink + (int32_t) (gps.location.lat() * 1e6);
+    }
+    end = std::chrono::steady_clock::now();
+    double tiny = std::chrono::duration<double, std::nano>(end - start).count() / ((double) stream.size() * rounds);
+    printf("TinyGPS++   %6.2f ns/char  %7.1f MB/s  speedup %.1fx\n", tiny, 1000 / tiny, tiny / nmea);
+#endif
+
+    return errors == 0 && fixes == 2 * seconds ? 0 : 1;
+}
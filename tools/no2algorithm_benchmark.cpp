@@ -0,0 +1,247 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host benchmark of the NO2 algorithms (no2algorithm.h) with the recorded measurements
+ * (csv files of data/). The compile-time strategies NO2Algorithm<N> with the directly indexed
+ * tables are compared with the former path: the float function of the simple formula
+ * (sensor passed by value) and a runtime switch over the algorithms with a searched
+ * temperature table. It checks that both give the same ppb and prints the time per
+ * conversion.
+ *
+ *   g++ -O2 -Itools/host -Isrc tools/no2algorithm_benchmark.cpp -o no2algorithm_benchmark
+ *   ./no2algorithm_benchmark data/no2-data_testrun_20180119.csv
+ */
+
+#include "no2algorithm.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// measurement.cpp needs the sensor libraries, so the constructor is repeated here
+NO2Sensor::NO2Sensor(uint32_t _serial_no, uint8_t _we_zero_electronic, uint8_t _we_zero_total, uint8_t _ae_zero_electronic, uint8_t _ae_zero_total, float _sensitivity)
+{
+    serial_no = _serial_no;
+    we_zero_electronic = _we_zero_electronic;
+    we_zero_total = _we_zero_total;
+    ae_zero_electronic = _ae_zero_electronic;
+    ae_zero_total = _ae_zero_total;
+    sensitivity = _sensitivity;
+}
+
+struct Sample
+{
+    float temperature, ae, we;
+};
+
+/*
+ * Former path: no2_algorithm_simple of NO2Measurement and a switch over the algorithms
+ * which searches the temperature of the table
+ */
+static const float legacy_temperatures[no2_table_size] = { -30, -20, -10, 0, 10, 20, 30, 40, 50 };
+
+static float legacy_interpolate(const float *table, float temperature)
+{
+    if (!(temperature > legacy_temperatures[0]))
+    {
+        return table[0];
+    }
+    for (int i = 1; i < no2_table_size; i++)
+    {
+        if (temperature < legacy_temperatures[i])
+        {
+            float f = (temperature - legacy_temperatures[i - 1]) / (legacy_temperatures[i] - legacy_temperatures[i - 1]);
+            return table[i - 1] + f * (table[i] - table[i - 1]);
+        }
+    }
+    return table[no2_table_size - 1];
+}
+
+static float legacy_simple(NO2Sensor sensor, float we, float ae)
+{
+    float c = we - sensor.we_zero_total;
+    if (c < 0)
+    {
+        c = 0;
+    }
+
+    float e = ae - sensor.ae_zero_total;
+    if (e < 0)
+    {
+        e = 0;
+    }
+
+    float g = c - e;
+    if (g < 0)
+    {
+        g = 0;
+    }
+    return g / sensor.sensitivity;
+}
+
+static float legacy_ppb(int algorithm, NO2Sensor sensor, float we, float ae, float temperature)
+{
+    float we_u = we - sensor.we_zero_electronic;
+    float ae_u = ae - sensor.ae_zero_electronic;
+    float we_0 = sensor.we_zero_total - sensor.we_zero_electronic;
+    float ae_0 = sensor.ae_zero_total - sensor.ae_zero_electronic;
+    float we_c;
+    switch (algorithm)
+    {
+        case NO2_ALGORITHM_1:
+            we_c = we_u - legacy_interpolate(no2_n_t, temperature) * ae_u;
+            break;
+        case NO2_ALGORITHM_2:
+            we_c = we_u - legacy_interpolate(no2_k_t, temperature) * (ae_0 != 0 ? we_0 / ae_0 : 1) * ae_u;
+            break;
+        case NO2_ALGORITHM_3:
+            we_c = we_u - (we_0 - ae_0) - legacy_interpolate(no2_k1_t, temperature) * ae_u;
+            break;
+        case NO2_ALGORITHM_4:
+            we_c = we_u - we_0 - legacy_interpolate(no2_k2_t, temperature);
+            break;
+        default:
+            return legacy_simple(sensor, we, ae);
+    }
+    return we_c < 0 ? 0 : we_c / sensor.sensitivity;
+}
+
+/*
+ * Reads temperature, ae and we (or the first sensor ae0/we0) of a recorded file
+ */
+static void read_csv(const char *path, std::vector<Sample> &samples)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return;
+    }
+
+    char line[512];
+    int columns[3] = { -1, -1, -1 };
+    if (fgets(line, sizeof(line), file) != NULL)
+    {
+        int column = 0;
+        for (char *token = strtok(line, ",\r\n"); token != NULL; token = strtok(NULL, ",\r\n"), column++)
+        {
+            if (strcmp(token, "temperature") == 0)
+            {
+                columns[0] = column;
+            }
+            else if (strcmp(token, "ae") == 0 || strcmp(token, "ae0") == 0)
+            {
+                columns[1] = column;
+            }
+            else if (strcmp(token, "we") == 0 || strcmp(token, "we0") == 0)
+            {
+                columns[2] = column;
+            }
+        }
+    }
+
+    while (columns[0] >= 0 && columns[1] >= 0 && columns[2] >= 0 && fgets(line, sizeof(line), file) != NULL)
+    {
+        float values[3] = { NAN, NAN, NAN };
+        int column = 0;
+        for (char *token = strtok(line, ",\r\n"); token != NULL; token = strtok(NULL, ",\r\n"), column++)
+        {
+            for (int i = 0; i < 3; i++)
+            {
+                if (columns[i] == column)
+                {
+                    values[i] = atof(token);
+                }
+            }
+        }
+        samples.push_back({ values[0], values[1], values[2] });
+    }
+    fclose(file);
+}
+
+static volatile float sink;
+
+template <int algorithm> static double template_nanoseconds(const NO2Sensor &sensor, const std::vector<Sample> &samples, int rounds)
+{
+    float sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (const Sample &s : samples)
+        {
+            sum += NO2Algorithm<algorithm>::ppb(sensor, s.we, s.ae, s.temperature);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    sink = sum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double) samples.size() * rounds);
+}
+
+static double legacy_nanoseconds(int algorithm, const NO2Sensor &sensor, const std::vector<Sample> &samples, int rounds)
+{
+    float sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; r++)
+    {
+        for (const Sample &s : samples)
+        {
+            sum += legacy_ppb(algorithm, sensor, s.we, s.ae, s.temperature);
+        }
+    }
+    auto end = std::chrono::steady_clock::now();
+    sink = sum;
+    return std::chrono::duration<double, std::nano>(end - start).count() / ((double) samples.size() * rounds);
+}
+
+template <int algorithm> static float template_ppb(const NO2Sensor &sensor, const Sample &s)
+{
+    return NO2Algorithm<algorithm>::ppb(sensor, s.we, s.ae, s.temperature);
+}
+
+typedef float (*Conversion)(const NO2Sensor &, const Sample &);
+typedef double (*Timing)(const NO2Sensor &, const std::vector<Sample> &, int);
+
+int main(int argc, char **argv)
+{
+    std::vector<Sample> samples;
+    for (int i = 1; i < argc; i++)
+    {
+        read_csv(argv[i], samples);
+    }
+    if (samples.empty())
+    {
+        fprintf(stderr, "usage: %s data/*.csv\n", argv[0]);
+        return 1;
+    }
+
+    // sensor of the first calibration run (see NO2Measurement::init)
+    const NO2Sensor sensor(202310057, 231, 225, 238, 234, 0.258);
+    const int rounds = 2000;
+    const Conversion conversions[] = { template_ppb<0>, template_ppb<1>, template_ppb<2>, template_ppb<3>, template_ppb<4> };
+    const Timing timings[] = { template_nanoseconds<0>, template_nanoseconds<1>, template_nanoseconds<2>,
+        template_nanoseconds<3>, template_nanoseconds<4> };
+
+    printf("%d recorded measurements\n", (int) samples.size());
+    int differences = 0;
+    for (int algorithm = 0; algorithm <= NO2_ALGORITHM_4; algorithm++)
+    {
+        float difference = 0;
+        for (const Sample &s : samples)
+        {
+            float d = fabsf(conversions[algorithm](sensor, s) - legacy_ppb(algorithm, sensor, s.we, s.ae, s.temperature));
+            difference = d > difference ? d : difference;
+        }
+        differences += difference > 0.001F;
+
+        double legacy = legacy_nanoseconds(algorithm, sensor, samples, rounds);
+        double table = timings[algorithm](sensor, samples, rounds);
+        printf("algorithm %d  switch %6.2f ns  template %6.2f ns  speedup %.1fx  max difference %.4f ppb\n",
+            algorithm, legacy, table, legacy / table, difference);
+    }
+    return differences == 0 ? 0 : 1;
+}
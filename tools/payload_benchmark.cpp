@@ -0,0 +1,362 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host benchmark of the uplink encodings with the recorded measurements (csv files of data/).
+ * For every encoding and datarate it reports the payload bytes per record, the number
+ * of frames and the airtime for 1000 records. The airtime is calculated with
+ * calcAirTime of the bundled LMIC for the whole frame (13 bytes LoRaWan overhead).
+ *
+ *   ascii       ascii lora-message (EnvironmentData::lora_message), one record per frame
+ *   bitpacked   single bit-packed payload (port 2), one record per frame
+ *   batch       bit-packed batch (port 3), as many records as fit into the frame
+ *   lpp         Cayenne LPP (temperature, humidity, barometer, GPS, analog inputs for
+ *               AE/WE and unix time), as many records as fit into the frame
+ *   cbor        CBOR array of maps with integer keys and the values in steps of the
+ *               payload resolution, as many records as fit into the frame
+ *   compressed  delta compressed batch (port 4)
+ *
+ * Build and run (see tools/payload_benchmark.sh):
+ *   tools/payload_benchmark.sh data/no2-data_testrun_20180119.csv  (default: all csv files of data/)
+ */
+
+#include "measurement.h"
+#include "payload.h"
+
+#include <lmic.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+const int datarate_count = 6; // DR0 (SF12) - DR5 (SF7) of EU868
+const int frame_overhead = OFF_DAT_OPTS + 5;
+
+/*
+ * Encodes the first records which fit into the buffer, returns the number of encoded
+ * records (0 if not even one record fits) and the length of the payload
+ */
+typedef int (*Encoder)(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length);
+
+static int encode_ascii(EnvironmentData *records, int, uint8_t *buffer, int size, int *length)
+{
+    *length = records[0].lora_message((char *) buffer, size);
+    return *length < size ? 1 : 0;
+}
+
+static int encode_bitpacked(EnvironmentData *records, int, uint8_t *buffer, int size, int *length)
+{
+    *length = records[0].lora_payload(buffer);
+    return *length <= size ? 1 : 0;
+}
+
+static int encode_batch(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length)
+{
+    return payload_encode_batch(records, count, buffer, size, length);
+}
+
+static int encode_compressed(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length)
+{
+    return payload_encode_compressed(records, count, buffer, size, length);
+}
+
+/*
+ * Cayenne LPP: channel, type and the big endian value of every sensor
+ */
+static void lpp_write(ByteWriter &writer, uint8_t channel, uint8_t type, int32_t value, int bytes)
+{
+    writer.write(channel);
+    writer.write(type);
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        writer.write(value >> (8 * i));
+    }
+}
+
+static int lpp_record(EnvironmentData &data, uint8_t *buffer, int size)
+{
+    ByteWriter writer(buffer, size);
+    if (!isnan(data.sht31_temperature))
+    {
+        lpp_write(writer, 1, 0x67, lround(data.sht31_temperature * 10), 2);
+    }
+    if (!isnan(data.sht31_humidity))
+    {
+        lpp_write(writer, 2, 0x68, lround(data.sht31_humidity * 2), 1);
+    }
+    if (!isnan(data.bmp180_pressure))
+    {
+        lpp_write(writer, 3, 0x73, lround(data.bmp180_pressure * 10), 2);
+    }
+    if (data.gps_latitude != 0 || data.gps_longitude != 0)
+    {
+        writer.write(4);
+        writer.write(0x88);
+        int32_t position[] = { (int32_t) lround(data.gps_latitude * 10000), (int32_t) lround(data.gps_longitude * 10000), (int32_t) lround(data.gps_altitude * 100) };
+        for (int32_t value : position)
+        {
+            writer.write(value >> 16);
+            writer.write(value >> 8);
+            writer.write(value);
+        }
+    }
+    lpp_write(writer, 5, 0x02, lround(data.no2_ae * 100), 2);
+    lpp_write(writer, 6, 0x02, lround(data.no2_we * 100), 2);
+    uint32_t timestamp = payload_timestamp(&data);
+    if (timestamp != 0xFFFFFFFF)
+    {
+        lpp_write(writer, 7, 0x85, timestamp + payload_epoch, 4);
+    }
+    return writer.bytes();
+}
+
+static int encode_lpp(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length)
+{
+    *length = 0;
+    int n = 0;
+    for (; n < count; n++)
+    {
+        int bytes = lpp_record(records[n], buffer + *length, size - *length);
+        if (*length + bytes > size)
+        {
+            break;
+        }
+        *length += bytes;
+    }
+    return n;
+}
+
+/*
+ * CBOR: header with the major type and the shortest argument
+ */
+static void cbor_head(ByteWriter &writer, uint8_t major, uint32_t argument)
+{
+    if (argument < 24)
+    {
+        writer.write((major << 5) | argument);
+        return;
+    }
+    int bytes = argument < 0x100 ? 1 : argument < 0x10000 ? 2 : 4;
+    writer.write((major << 5) | (bytes == 1 ? 24 : bytes == 2 ? 25 : 26));
+    for (int i = bytes - 1; i >= 0; i--)
+    {
+        writer.write(argument >> (8 * i));
+    }
+}
+
+static void cbor_int(ByteWriter &writer, int32_t value)
+{
+    if (value >= 0)
+    {
+        cbor_head(writer, 0, value);
+    }
+    else
+    {
+        cbor_head(writer, 1, -1 - value);
+    }
+}
+
+static int cbor_record(EnvironmentData &data, uint8_t *buffer, int size)
+{
+    int32_t fields[payload_field_count];
+    data.payload_fields(fields);
+
+    int present = 0;
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        present += fields[field] != payload_missing(field);
+    }
+
+    ByteWriter writer(buffer, size);
+    cbor_head(writer, 5, present);
+    for (int field = 0; field < payload_field_count; field++)
+    {
+        if (fields[field] != payload_missing(field))
+        {
+            cbor_int(writer, field);
+            cbor_int(writer, fields[field]);
+        }
+    }
+    return writer.bytes();
+}
+
+static int encode_cbor(EnvironmentData *records, int count, uint8_t *buffer, int size, int *length)
+{
+    // the array header needs one byte for up to 23 records
+    *length = 1;
+    int n = 0;
+    for (; n < count && n < 23; n++)
+    {
+        int bytes = cbor_record(records[n], buffer + *length, size - *length);
+        if (*length + bytes > size)
+        {
+            break;
+        }
+        *length += bytes;
+    }
+    ByteWriter writer(buffer, size);
+    cbor_head(writer, 4, n);
+    return n;
+}
+
+struct Encoding
+{
+    const char *name;
+    Encoder encode;
+};
+
+static const Encoding encodings[] = {
+    { "ascii", encode_ascii },
+    { "bitpacked", encode_bitpacked },
+    { "batch", encode_batch },
+    { "lpp", encode_lpp },
+    { "cbor", encode_cbor },
+    { "compressed", encode_compressed },
+};
+
+/*
+ * Reads the recorded measurements (the columns differ between the files, ae/we are
+ * taken from "ae"/"we" or from the first sensor "ae0"/"we0")
+ */
+static std::vector<EnvironmentData> read_csv(const char *path)
+{
+    std::vector<EnvironmentData> records;
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        perror(path);
+        return records;
+    }
+
+    char line[512];
+    int columns[9];
+    const char *names[][2] = { { "date", "date" }, { "time", "time" }, { "latitude", "latitude" }, { "longitude", "longitude" },
+        { "temperature", "temperature" }, { "humidity", "humidity" }, { "pressure", "pressure" }, { "ae", "ae0" }, { "we", "we0" } };
+    if (fgets(line, sizeof(line), file) == NULL)
+    {
+        fclose(file);
+        return records;
+    }
+    for (int i = 0; i < 9; i++)
+    {
+        columns[i] = -1;
+        int column = 0;
+        for (char *start = line; start != NULL; column++)
+        {
+            size_t length = strcspn(start, ",\r\n");
+            if ((strlen(names[i][0]) == length && strncmp(start, names[i][0], length) == 0) ||
+                (strlen(names[i][1]) == length && strncmp(start, names[i][1], length) == 0))
+            {
+                columns[i] = column;
+            }
+            start = start[length] == ',' ? start + length + 1 : NULL;
+        }
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        char *values[16];
+        int count = 0;
+        for (char *token = strtok(line, ",\r\n"); token != NULL && count < 16; token = strtok(NULL, ",\r\n"))
+        {
+            values[count++] = token;
+        }
+
+        EnvironmentData data;
+        int year = 0, month = 0, day = 0, hour = 0, minute = 0, second = 0;
+        if (columns[0] >= 0 && columns[0] < count)
+        {
+            sscanf(values[columns[0]], "%d-%d-%d", &year, &month, &day);
+        }
+        if (columns[1] >= 0 && columns[1] < count)
+        {
+            sscanf(values[columns[1]], "%d:%d:%d", &hour, &minute, &second);
+        }
+        data.gps_year = year;
+        data.gps_month = month;
+        data.gps_day = day;
+        data.gps_hour = hour;
+        data.gps_minute = minute;
+        data.gps_second = second;
+
+        double numbers[9];
+        for (int i = 2; i < 9; i++)
+        {
+            numbers[i] = columns[i] >= 0 && columns[i] < count ? atof(values[columns[i]]) : NAN;
+        }
+        data.gps_latitude = numbers[2];
+        data.gps_longitude = numbers[3];
+        data.sht31_temperature = numbers[4];
+        data.sht31_humidity = numbers[5];
+        data.bmp180_pressure = numbers[6];
+        data.no2_ae = numbers[7];
+        data.no2_we = numbers[8];
+        data.no2_ppb = 0;
+        records.push_back(data);
+    }
+    fclose(file);
+    return records;
+}
+
+static void benchmark(const char *name, std::vector<EnvironmentData> &records)
+{
+    printf("%s (%d records)\n", name, (int) records.size());
+    printf("  %-11s %3s %9s %13s %15s\n", "encoding", "DR", "bytes/rec", "frames/1000", "airtime/1000 s");
+    for (const Encoding &encoding : encodings)
+    {
+        for (int datarate = 0; datarate < datarate_count; datarate++)
+        {
+            LMIC.datarate = datarate;
+            int size = LMIC_maxPayloadLen();
+            uint8_t buffer[payload_batch_size_max];
+
+            long bytes = 0;
+            long frames = 0;
+            double airtime = 0;
+            int count = records.size();
+            for (int i = 0; i < count; )
+            {
+                int length;
+                int n = encoding.encode(&records[i], count - i, buffer, size, &length);
+                if (n == 0)
+                {
+                    break;
+                }
+                bytes += length;
+                frames++;
+                airtime += osticks2ms(calcAirTime(updr2rps(datarate), length + frame_overhead)) / 1000.0;
+                i += n;
+            }
+            printf("  %-11s %3d %9.1f %13.1f %15.1f\n", encoding.name, datarate,
+                (double) bytes / count, frames * 1000.0 / count, airtime * 1000.0 / count);
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    if (argc < 2)
+    {
+        fprintf(stderr, "usage: %s data/*.csv\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<EnvironmentData> all;
+    for (int i = 1; i < argc; i++)
+    {
+        std::vector<EnvironmentData> records = read_csv(argv[i]);
+        if (!records.empty())
+        {
+            benchmark(argv[i], records);
+            all.insert(all.end(), records.begin(), records.end());
+        }
+    }
+    if (argc > 2 && !all.empty())
+    {
+        benchmark("all files", all);
+    }
+    return 0;
+}
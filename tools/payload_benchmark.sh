@@ -0,0 +1,22 @@
+#!/bin/sh
+#
+# Builds the payload benchmark for the host and runs it with the given csv files
+# (default: data/*.csv), e.g. tools/payload_benchmark.sh data/no2-data_testrun_20180119.csv
+#
+
+set -e
+cd "$(dirname "$0")/.."
+
+BUILD=${BUILD:-.pio/payload_benchmark}
+mkdir -p "$BUILD"
+
+# only calcAirTime and the datarate tables of LMIC are used, the radio and HAL are dropped by the linker
+gcc -O2 -std=gnu99 -ffunction-sections -fdata-sections -Isrc/lmic -Isrc/hal -c src/lmic/lmic.c -o "$BUILD/lmic.o"
+g++ -O2 -std=c++11 -ffunction-sections -fdata-sections -Itools/host -Isrc -Isrc/lmic -Isrc/hal \
+    tools/payload_benchmark.cpp src/payload.cpp src/message.cpp src/textwriter.cpp "$BUILD/lmic.o" \
+    -Wl,--gc-sections -o "$BUILD/payload_benchmark"
+
+if [ $# -eq 0 ]; then
+    set -- data/*.csv
+fi
+"$BUILD/payload_benchmark" "$@"
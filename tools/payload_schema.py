@@ -0,0 +1,184 @@
+#
+# ----------------------------------------------------------------------------
+# NO2 measurement with ESP32 and LoRaWan
+# https://github.com/rmh78/NO2-Measurement
+# ----------------------------------------------------------------------------
+#
+# Generates the TTN payload formatter (ttn/payload-formatter.js) from the payload
+# schema in src/payloadschema.h, so the decoder of the backend always matches the
+# encoder of the device. PlatformIO runs it before each build (extra_scripts in
+# platformio.ini), it can also be called directly: python tools/payload_schema.py
+#
+
+import os
+import re
+
+try:
+    Import("env")
+    project_dir = env.subst("$PROJECT_DIR")
+except NameError:
+    project_dir = os.path.join(os.path.dirname(os.path.abspath(__file__)), "..")
+
+schema_path = os.path.join(project_dir, "src", "payloadschema.h")
+payload_path = os.path.join(project_dir, "src", "payload.h")
+formatter_path = os.path.join(project_dir, "ttn", "payload-formatter.js")
+
+FIELD = re.compile(r"FIELD\((\w+),\s*(\d+),\s*([-\d.]+),\s*([-\d.]+),\s*(true|false),")
+
+TEMPLATE = """// generated by tools/payload_schema.py from src/payloadschema.h - do not edit
+var VERSION = %(version)d;
+var EPOCH = %(epoch)d; // timestamps are seconds since 2018-01-01 (local time of the GPS)
+var FIELDS = [
+%(fields)s
+];
+
+function missingSteps(field) {
+  return field.signed ? -Math.pow(2, field.bits - 1) : Math.pow(2, field.bits) - 1;
+}
+
+function fieldValue(field, steps) {
+  if (steps === missingSteps(field)) {
+    return field.name === "samples" ? 1 : null; // a record which was not downsampled
+  }
+  if (field.name === "timestamp") {
+    return new Date((steps + EPOCH) * 1000).toISOString().substring(0, 19);
+  }
+  return Number((steps * field.resolution + field.offset).toFixed(field.decimals));
+}
+
+function bitReader(bytes, position) {
+  return function (bits, signed) {
+    var value = 0;
+    for (var i = 0; i < bits; i++, position++) {
+      value = value * 2 + ((bytes[position >> 3] >> (7 - (position & 7))) & 1);
+    }
+    if (signed && value >= Math.pow(2, bits - 1)) {
+      value -= Math.pow(2, bits);
+    }
+    return value;
+  };
+}
+
+// presence bitmap (one bit per field) followed by the available fields
+function readRecord(read) {
+  var present = [], record = {};
+  for (var i = 0; i < FIELDS.length; i++) {
+    present[i] = read(1, false);
+  }
+  for (i = 0; i < FIELDS.length; i++) {
+    record[FIELDS[i].name] = fieldValue(FIELDS[i], present[i] ? read(FIELDS[i].bits, FIELDS[i].signed) : missingSteps(FIELDS[i]));
+  }
+  return record;
+}
+
+function decodeCompressed(bytes) {
+  var position = 0;
+  function zigzag() {
+    var value = 0, factor = 1, b;
+    do {
+      b = bytes[position++];
+      value += (b & 0x7f) * factor;
+      factor *= 128;
+    } while (b & 0x80);
+    return value %% 2 ? -(value + 1) / 2 : value / 2;
+  }
+  var count = bytes[position++] & 0x0f;
+  var present = bytes[position] | (bytes[position + 1] << 8);
+  var constant = bytes[position + 2] | (bytes[position + 3] << 8);
+  position += 4;
+  var steps = [], interval = 0, records = [];
+  for (var f = 0; f < FIELDS.length; f++) {
+    steps[f] = (present >> f) & 1 ? zigzag() : missingSteps(FIELDS[f]);
+  }
+  for (var i = 0; i < count; i++) {
+    if (i > 0) {
+      for (f = 0; f < FIELDS.length; f++) {
+        if (!((present >> f) & 1) || ((constant >> f) & 1)) {
+          continue;
+        }
+        if (FIELDS[f].name === "timestamp") {
+          interval += zigzag();
+          steps[f] += interval;
+        } else {
+          steps[f] += zigzag();
+        }
+      }
+    }
+    var record = {};
+    for (f = 0; f < FIELDS.length; f++) {
+      record[FIELDS[f].name] = fieldValue(FIELDS[f], steps[f]);
+    }
+    records.push(record);
+  }
+  return records;
+}
+
+// TTN v2
+function Decoder(bytes, port) {
+  if (bytes.length === 0 || (bytes[0] >> 4) !== VERSION) {
+    return { error: "unknown payload version" };
+  }
+  if (port === %(port)d) {
+    return readRecord(bitReader(bytes, 4));
+  }
+  if (port === %(batch_port)d) {
+    var read = bitReader(bytes, 8), records = [];
+    for (var i = 0; i < (bytes[0] & 0x0f); i++) {
+      records.push(readRecord(read));
+    }
+    return { records: records };
+  }
+  if (port === %(compressed_port)d) {
+    return { records: decodeCompressed(bytes) };
+  }
+  return { error: "unknown port" };
+}
+
+// TTN v3
+function decodeUplink(input) {
+  var data = Decoder(input.bytes, input.fPort);
+  return data.error ? { errors: [data.error] } : { data: data };
+}
+"""
+
+
+def constant(source, name):
+    return int(re.search(name + r"\s*=\s*(\d+)", source).group(1))
+
+
+def decimals(resolution):
+    text = ("%.10f" % float(resolution)).rstrip("0")
+    return len(text.split(".")[1]) if "." in text else 0
+
+
+def generate():
+    with open(schema_path) as f:
+        schema = f.read()
+    with open(payload_path) as f:
+        payload = f.read()
+
+    fields = []
+    for name, bits, resolution, offset, signed in FIELD.findall(schema):
+        fields.append('  { name: "%s", bits: %s, resolution: %s, offset: %s, signed: %s, decimals: %d }'
+                      % (name, bits, resolution, offset, signed, decimals(resolution)))
+
+    formatter = TEMPLATE % {
+        "version": int(re.search(r"#define PAYLOAD_VERSION (\d+)", schema).group(1)),
+        "epoch": constant(payload, "payload_epoch"),
+        "port": constant(payload, "payload_port"),
+        "batch_port": constant(payload, "payload_batch_port"),
+        "compressed_port": constant(payload, "payload_compressed_port"),
+        "fields": ",\n".join(fields),
+    }
+
+    old = None
+    if os.path.exists(formatter_path):
+        with open(formatter_path) as f:
+            old = f.read()
+    if formatter != old:
+        with open(formatter_path, "w") as f:
+            f.write(formatter)
+        print("generated " + formatter_path)
+
+
+generate()
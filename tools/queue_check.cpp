@@ -0,0 +1,302 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host check of the persistent queue (src/persistentqueue.cpp) on a simulated NOR flash
+ * partition of the size of partitions.csv: a write only clears bits, an erase sets a
+ * whole sector to 0xFF and a brown-out stops the flash after a random number of bytes.
+ *   recovery  random enqueues and acknowledges with a brown-out in between (and some
+ *             during the start), after every start (begin, recover, loadTail) the queue
+ *             must hold the records of the model, only the record or the acknowledge
+ *             which was written may be lost
+ *   outage    the queue downsamples a long outage instead of dropping records: all
+ *             measurements are kept, the newest at full resolution, no record stands
+ *             for more measurements than the uplink can tell
+ *   gap       records of both sides of a gap of the measurements are never merged
+ *
+ *   sh tools/host_checks.sh
+ */
+
+#include "persistentqueue.h"
+#include "payloadschema.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+HostSerial Serial;
+
+static const size_t flashSize = 0x40000;   // queue partition of partitions.csv
+static const uint32_t interval = 600;      // seconds between two measurements
+static uint8_t flash[flashSize];
+static esp_partition_t partition = { 0x3C0000, flashSize, "queue" };
+static long writeBudget = -1;              // bytes until the brown-out, -1 = none
+
+struct BrownOut {};
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t, int, const char *)
+{
+    return &partition;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *, size_t offset, void *data, size_t length)
+{
+    if (offset + length > flashSize)
+    {
+        return ESP_FAIL;
+    }
+    memcpy(data, flash + offset, length);
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_write(const esp_partition_t *, size_t offset, const void *data, size_t length)
+{
+    if (offset + length > flashSize)
+    {
+        return ESP_FAIL;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        if (writeBudget == 0)
+        {
+            throw BrownOut();
+        }
+        writeBudget -= writeBudget > 0;
+        flash[offset + i] &= ((const uint8_t *) data)[i];
+    }
+    return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *, size_t offset, size_t length)
+{
+    if (offset % PersistentQueue::sectorSize != 0 || length % PersistentQueue::sectorSize != 0 || offset + length > flashSize)
+    {
+        return ESP_FAIL;
+    }
+    if (writeBudget == 0)
+    {
+        throw BrownOut();
+    }
+    memset(flash + offset, 0xFF, length);
+    return ESP_OK;
+}
+
+static MeasurementRecord measurement(uint32_t number)
+{
+    MeasurementRecord record;
+    memset(&record, 0, sizeof(record));
+    record.timestamp = 1000 + number * interval;
+    record.temperature = number % 1000;
+    record.no2_ae = number % 8000;
+    record.no2_we = 2 * (number % 8000);
+    record.humidity = record_missing;
+    record.samples = 1;
+    return record;
+}
+
+static std::vector<uint32_t> without_holes(const std::vector<uint32_t> &records)
+{
+    std::vector<uint32_t> readable;
+    for (size_t i = 0; i < records.size(); i++)
+    {
+        if (records[i] != 0)
+        {
+            readable.push_back(records[i]);
+        }
+    }
+    return readable;
+}
+
+static bool check_recovery()
+{
+    srand(1);
+    for (size_t i = 0; i < flashSize; i++)
+    {
+        flash[i] = rand();  // a partition which was never used
+    }
+
+    std::vector<uint32_t> model;    // timestamps of the records which are not acknowledged, 0 = torn slot
+    uint32_t next = 0;
+    int interrupted = 0;            // records of the acknowledge which was interrupted
+    long lost = 0;
+    int interruptedStarts = 0;      // brown-outs in begin or in the drop of a torn slot
+    for (int start = 0; start < 2000; start++)
+    {
+        PersistentQueue queue;
+        // an unreadable oldest record is dropped by peek, the others are holes of the queue
+        std::vector<uint32_t> records;
+        MeasurementRecord record;
+        writeBudget = rand() % 4 == 0 ? rand() % 200 : -1;
+        try
+        {
+            if (!queue.begin("queue", interval))
+            {
+                printf("recovery: begin failed at start %d\n", start);
+                return false;
+            }
+            for (int i = 0; i < queue.count(); i++)
+            {
+                bool readable = queue.peek(i, &record);
+                if (i < queue.count())
+                {
+                    records.push_back(readable ? record.timestamp : 0);
+                }
+            }
+        }
+        catch (BrownOut &)
+        {
+            // the next start must still find the records of the model
+            interruptedStarts++;
+            continue;
+        }
+        writeBudget = -1;
+
+        // the brown-out may have lost the enqueue (last record of the model, its slot may
+        // be a hole) or the acknowledge (records of the model are still in front of the
+        // queue), an interrupted acknowledge may also have been written completely
+        std::vector<uint32_t> readable = without_holes(records);
+        std::vector<uint32_t> expected = without_holes(model);
+        bool enqueueLost = !model.empty() && model.back() != 0
+            && readable == std::vector<uint32_t>(expected.begin(), expected.end() - 1);
+        bool ackWritten = interrupted > 0
+            && readable == without_holes(std::vector<uint32_t>(model.begin() + interrupted, model.end()));
+        bool ackLost = readable.size() >= expected.size()
+            && std::vector<uint32_t>(readable.end() - expected.size(), readable.end()) == expected;
+        if (!enqueueLost && !ackWritten && !ackLost)
+        {
+            printf("recovery: %zu records after start %d, %zu expected\n", readable.size(), start, expected.size());
+            return false;
+        }
+        lost += enqueueLost;
+        model = records;
+
+        interrupted = 0;
+        writeBudget = rand() % 4000;
+        try
+        {
+            for (int i = 0; i < 200; i++)
+            {
+                if (rand() % 3 < 2)
+                {
+                    MeasurementRecord record = measurement(next++);
+                    model.push_back(record.timestamp);
+                    if (!queue.enqueue(&record))
+                    {
+                        model.pop_back();
+                    }
+                }
+                else
+                {
+                    int n = std::min(rand() % 5 + 1, queue.count());
+                    interrupted = n;
+                    if (n > 0 && queue.ack(n))
+                    {
+                        model.erase(model.begin(), model.begin() + n);
+                    }
+                    interrupted = 0;
+                }
+                if ((int) model.size() != queue.count())
+                {
+                    printf("recovery: count %d, %zu expected\n", queue.count(), model.size());
+                    return false;
+                }
+            }
+        }
+        catch (BrownOut &)
+        {
+        }
+    }
+    writeBudget = -1;
+    printf("recovery: ok, 2000 starts (%d interrupted), %ld records lost in the write of the brown-out\n",
+        interruptedStarts, lost);
+    return true;
+}
+
+static bool check_outage()
+{
+    memset(flash, 0xFF, flashSize);
+    PersistentQueue queue;
+    queue.begin("queue", interval);
+
+    const uint32_t measurements = 40000;   // more than 9 months at 10 minutes
+    uint32_t generation = queue.generation();
+    for (uint32_t i = 0; i < measurements; i++)
+    {
+        MeasurementRecord record = measurement(i);
+        if (!queue.enqueue(&record))
+        {
+            printf("outage: enqueue %u failed\n", i);
+            return false;
+        }
+    }
+
+    uint32_t samples = 0;
+    uint32_t maximum = 0;
+    int mixed = 0;
+    MeasurementRecord record;
+    for (int i = 0; i < queue.count(); i++)
+    {
+        queue.peek(i, &record);
+        samples += record.samples;
+        maximum = std::max<uint32_t>(maximum, record.samples);
+        // the values are means of the same measurements: we = 2 * ae
+        mixed += abs(record.no2_we - 2 * record.no2_ae) > 1;
+    }
+    queue.peek(queue.count() - 1, &record);
+    bool newest = record.timestamp == measurement(measurements - 1).timestamp && record.samples == 1;
+    uint32_t samplesMax = (1UL << payload_schema[PAYLOAD_samples].bits) - 2;
+
+    printf("outage: %d records for %u measurements (%u kept), up to %u per record\n",
+        queue.count(), measurements, samples, maximum);
+    if (samples != measurements || !newest || mixed > 0 || maximum > samplesMax || queue.generation() == generation)
+    {
+        printf("outage: failed (newest %d, inconsistent means %d, generation %u)\n", newest, mixed, queue.generation());
+        return false;
+    }
+    return true;
+}
+
+static bool check_gap()
+{
+    memset(flash, 0xFF, flashSize);
+    PersistentQueue queue;
+    queue.begin("queue", interval);
+
+    // 4000 measurements before and 16000 after a gap of 5 days, the temperature tells
+    // the sides apart (a merged record of both sides has a mean in between)
+    const int before = 4000;
+    uint32_t time = 1000;
+    for (int i = 0; i < 20000; i++)
+    {
+        MeasurementRecord record = measurement(i);
+        record.timestamp = time;
+        record.temperature = i < before ? 0 : 10000;
+        queue.enqueue(&record);
+        time += i == before - 1 ? 5 * 86400 : interval;
+    }
+
+    int mixed = 0;
+    uint32_t samples = 0;
+    MeasurementRecord record;
+    for (int i = 0; i < queue.count(); i++)
+    {
+        queue.peek(i, &record);
+        samples += record.samples;
+        mixed += record.temperature > 0 && record.temperature < 10000;
+    }
+    printf("gap: %d records for 20000 measurements (%u kept), %d across the gap\n", queue.count(), samples, mixed);
+    return mixed == 0 && samples == 20000;
+}
+
+int main()
+{
+    Serial.out = NULL;
+    bool success = check_recovery();
+    success = check_outage() && success;
+    success = check_gap() && success;
+    printf("%s\n", success ? "queue checks passed" : "queue checks FAILED");
+    return success ? 0 : 1;
+}
@@ -0,0 +1,165 @@
+/*
+ * ----------------------------------------------------------------------------
+ * NO2 measurement with ESP32 and LoRaWan
+ * https://github.com/rmh78/NO2-Measurement
+ * ----------------------------------------------------------------------------
+ *
+ * Host stress test and benchmark of SPSCRing (src/spscring.h) against a mutex queue
+ * (std::mutex and condition variables) which copies every item in and out under the
+ * lock. It is not the FreeRTOS queue: xQueueSend/xQueueReceive also copy under a
+ * critical section, but their cost on the ESP32 is only known from a measurement on
+ * the target. A producer and a consumer thread pass items of the size of a GPS fix;
+ * the consumer checks that every item arrives once, in order and unchanged (the ring
+ * is small, so producer and consumer overtake each other often).
+ *
+ *   g++ -O2 -std=c++11 -pthread -Isrc tools/spsc_benchmark.cpp -o spsc_benchmark
+ *   ./spsc_benchmark
+ */
+
+#include "spscring.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <mutex>
+#include <thread>
+
+struct Item
+{
+    uint32_t sequence;
+    uint32_t values[8];
+    uint32_t check;
+};
+
+static void fill(Item &item, uint32_t sequence)
+{
+    item.sequence = sequence;
+    item.check = sequence;
+    for (int i = 0; i < 8; i++)
+    {
+        item.values[i] = sequence * 2654435761U + i;
+        item.check ^= item.values[i];
+    }
+}
+
+static bool verify(const Item &item, uint32_t sequence)
+{
+    uint32_t check = item.sequence;
+    for (int i = 0; i < 8; i++)
+    {
+        check ^= item.values[i];
+    }
+    return item.sequence == sequence && check == item.check;
+}
+
+/*
+ * Mutex queue with a copy in and out under the lock
+ */
+template <int size> class MutexQueue
+{
+public:
+    void send(const Item &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return count < size; });
+        items[(first + count) % size] = item;
+        count++;
+        notEmpty.notify_one();
+    }
+
+    void receive(Item &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return count > 0; });
+        item = items[first];
+        first = (first + 1) % size;
+        count--;
+        notFull.notify_one();
+    }
+
+private:
+    Item items[size];
+    int first = 0;
+    int count = 0;
+    std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+};
+
+const int ringSize = 16;
+const uint32_t itemCount = 5000000;
+
+static double run_ring(uint32_t *errors)
+{
+    SPSCRing<Item, ringSize> ring;
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([&ring] {
+        for (uint32_t i = 0; i < itemCount; )
+        {
+            Item *slot = ring.acquire();
+            if (slot == NULL)
+            {
+                std::this_thread::yield();
+                continue;
+            }
+            fill(*slot, i++);
+            ring.commit();
+        }
+    });
+
+    uint32_t expected = 0;
+    while (expected < itemCount)
+    {
+        Item *item = ring.peek();
+        if (item == NULL)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        *errors += !verify(*item, expected++);
+        ring.ack();
+    }
+    producer.join();
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / itemCount;
+}
+
+static double run_queue(uint32_t *errors)
+{
+    static MutexQueue<ringSize> queue;
+    auto start = std::chrono::steady_clock::now();
+
+    std::thread producer([] {
+        Item item;
+        for (uint32_t i = 0; i < itemCount; i++)
+        {
+            fill(item, i);
+            queue.send(item);
+        }
+    });
+
+    Item item;
+    for (uint32_t expected = 0; expected < itemCount; expected++)
+    {
+        queue.receive(item);
+        *errors += !verify(item, expected);
+    }
+    producer.join();
+
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / itemCount;
+}
+
+int main()
+{
+    uint32_t ringErrors = 0;
+    uint32_t queueErrors = 0;
+    double ring = run_ring(&ringErrors);
+    double queue = run_queue(&queueErrors);
+    printf("%u items of %d bytes, %d slots\n", itemCount, (int) sizeof(Item), ringSize);
+    printf("SPSCRing     %6.1f ns/item  errors: %u\n", ring, ringErrors);
+    printf("mutex queue  %6.1f ns/item  errors: %u\n", queue, queueErrors);
+    return ringErrors == 0 && queueErrors == 0 ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// generated by tools/payload_schema.py from src/payloadschema.h - do not edit
+var VERSION = 6;
+var EPOCH = 1514764800; // timestamps are seconds since 2018-01-01 (local time of the GPS)
+var FIELDS = [
+  { name: "temperature", bits: 11, resolution: 0.1, offset: -40, signed: false, decimals: 1 },
+  { name: "humidity", bits: 8, resolution: 0.5, offset: 0, signed: false, decimals: 1 },
+  { name: "pressure", bits: 12, resolution: 0.1, offset: 800, signed: false, decimals: 1 },
+  { name: "timestamp", bits: 30, resolution: 1, offset: 0, signed: false, decimals: 0 },
+  { name: "latitude", bits: 20, resolution: 0.00001, offset: 48.15, signed: true, decimals: 5 },
+  { name: "longitude", bits: 20, resolution: 0.00001, offset: 11.54, signed: true, decimals: 5 },
+  { name: "ae", bits: 15, resolution: 0.03125, offset: 0, signed: false, decimals: 5 },
+  { name: "we", bits: 15, resolution: 0.03125, offset: 0, signed: false, decimals: 5 },
+  { name: "we_stddev", bits: 10, resolution: 0.03125, offset: 0, signed: false, decimals: 5 },
+  { name: "ae_stddev", bits: 10, resolution: 0.03125, offset: 0, signed: false, decimals: 5 },
+  { name: "o3", bits: 11, resolution: 0.5, offset: 0, signed: false, decimals: 1 },
+  { name: "co", bits: 14, resolution: 1, offset: 0, signed: false, decimals: 0 },
+  { name: "ugm3", bits: 13, resolution: 0.1, offset: 0, signed: false, decimals: 1 },
+  { name: "calibration", bits: 12, resolution: 1, offset: 0, signed: false, decimals: 0 },
+  { name: "samples", bits: 10, resolution: 1, offset: 0, signed: false, decimals: 0 }
+];
+
+function missingSteps(field) {
+  return field.signed ? -Math.pow(2, field.bits - 1) : Math.pow(2, field.bits) - 1;
+}
+
+function fieldValue(field, steps) {
+  if (steps === missingSteps(field)) {
+    return field.name === "samples" ? 1 : null; // a record which was not downsampled
+  }
+  if (field.name === "timestamp") {
+    return new Date((steps + EPOCH) * 1000).toISOString().substring(0, 19);
+  }
+  return Number((steps * field.resolution + field.offset).toFixed(field.decimals));
+}
+
+function bitReader(bytes, position) {
+  return function (bits, signed) {
+    var value = 0;
+    for (var i = 0; i < bits; i++, position++) {
+      value = value * 2 + ((bytes[position >> 3] >> (7 - (position & 7))) & 1);
+    }
+    if (signed && value >= Math.pow(2, bits - 1)) {
+      value -= Math.pow(2, bits);
+    }
+    return value;
+  };
+}
+
+// presence bitmap (one bit per field) followed by the available fields
+function readRecord(read) {
+  var present = [], record = {};
+  for (var i = 0; i < FIELDS.length; i++) {
+    present[i] = read(1, false);
+  }
+  for (i = 0; i < FIELDS.length; i++) {
+    record[FIELDS[i].name] = fieldValue(FIELDS[i], present[i] ? read(FIELDS[i].bits, FIELDS[i].signed) : missingSteps(FIELDS[i]));
+  }
+  return record;
+}
+
+function decodeCompressed(bytes) {
+  var position = 0;
+  function zigzag() {
+    var value = 0, factor = 1, b;
+    do {
+      b = bytes[position++];
+      value += (b & 0x7f) * factor;
+      factor *= 128;
+    } while (b & 0x80);
+    return value % 2 ? -(value + 1) / 2 : value / 2;
+  }
+  var count = bytes[position++] & 0x0f;
+  var present = bytes[position] | (bytes[position + 1] << 8);
+  var constant = bytes[position + 2] | (bytes[position + 3] << 8);
+  position += 4;
+  var steps = [], interval = 0, records = [];
+  for (var f = 0; f < FIELDS.length; f++) {
+    steps[f] = (present >> f) & 1 ? zigzag() : missingSteps(FIELDS[f]);
+  }
+  for (var i = 0; i < count; i++) {
+    if (i > 0) {
+      for (f = 0; f < FIELDS.length; f++) {
+        if (!((present >> f) & 1) || ((constant >> f) & 1)) {
+          continue;
+        }
+        if (FIELDS[f].name === "timestamp") {
+          interval += zigzag();
+          steps[f] += interval;
+        } else {
+          steps[f] += zigzag();
+        }
+      }
+    }
+    var record = {};
+    for (f = 0; f < FIELDS.length; f++) {
+      record[FIELDS[f].name] = fieldValue(FIELDS[f], steps[f]);
+    }
+    records.push(record);
+  }
+  return records;
+}
+
+// TTN v2
+function Decoder(bytes, port) {
+  if (bytes.length === 0 || (bytes[0] >> 4) !== VERSION) {
+    return { error: "unknown payload version" };
+  }
+  if (port === 2) {
+    return readRecord(bitReader(bytes, 4));
+  }
+  if (port === 3) {
+    var read = bitReader(bytes, 8), records = [];
+    for (var i = 0; i < (bytes[0] & 0x0f); i++) {
+      records.push(readRecord(read));
+    }
+    return { records: records };
+  }
+  if (port === 4) {
+    return { records: decodeCompressed(bytes) };
+  }
+  return { error: "unknown port" };
+}
+
+// TTN v3
+function decodeUplink(input) {
+  var data = Decoder(input.bytes, input.fPort);
+  return data.error ? { errors: [data.error] } : { data: data };
+}